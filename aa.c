@@ -0,0 +1,128 @@
+/* Edge coverage for anti-aliasing. The subrays of
+ * a column are one bundle, a gcc vector of AA_SUB
+ * floats, so the wall span and coverage of every
+ * subray is worked out together.
+ */
+
+#include <ncurses.h>
+#include <stdint.h>
+
+#include "aa.h"
+#include "light.h"
+#include "resize.h"
+#include "term.h"
+
+// coverage up to this is left as background, and
+// from 1 minus it is solid wall
+#define EDGE_MIN 0.25f
+
+typedef float bundle __attribute__((vector_size(AA_SUB * sizeof(float))));
+typedef int32_t bundleMask __attribute__((vector_size(AA_SUB * sizeof(float))));
+
+// subray hits, one buffer per rendering thread
+static __thread struct rayHit *subrays;
+
+bool initEdgePairs() {
+  if (termPairs() < EDGE_PAIR_START + AA_BACKGROUNDS * SHADES)
+    return false;
+
+  // floor backgrounds sit in the middle of their step
+  int step = SHADES / (AA_BACKGROUNDS - 1);
+  for (int b = 0; b < AA_BACKGROUNDS; b++) {
+    short background = b == 0 ? BLACK :
+                       FLOOR_SHADE_START + (b - 1) * step + step / 2;
+    for (int s = 0; s < SHADES; s++)
+      setPair(EDGE_PAIR_START + b * SHADES + s, WALL_SHADE_START + s,
+              background);
+  }
+  return true;
+}
+
+void resizeAA() {
+  subrays = threadScratch()->subrays;
+}
+
+void recordSubray(int col, const struct rayHit *hit) {
+  subrays[col] = *hit;
+}
+
+static bundle bundleMin(bundle a, bundle b) {
+  bundleMask less = a < b;
+  return (bundle) (((bundleMask) a & less) | ((bundleMask) b & ~less));
+}
+
+static bundle bundleMax(bundle a, bundle b) {
+  bundleMask less = a < b;
+  return (bundle) (((bundleMask) b & less) | ((bundleMask) a & ~less));
+}
+
+// average share of row that lies within [top, bottom)
+static float coverage(bundle top, bundle bottom, int row) {
+  bundle zero = { 0 };
+  bundle overlap = bundleMin(bottom, zero + (float) (row + 1)) -
+                   bundleMax(top, zero + (float) row);
+  overlap = bundleMax(overlap, zero);
+  float sum = 0;
+  for (int i = 0; i < AA_SUB; i++)
+    sum += overlap[i];
+  return sum / AA_SUB;
+}
+
+// redraws one cell where the wall meets the ceiling
+// or floor, when it should look different from how
+// the column drew it
+static void drawEdge(struct view *v, int col, int row, int h, int ceiling,
+                     int floor, short pair, float covered) {
+  if (row < 0 || row >= h)
+    return;
+
+  bool drawnAsWall = row >= ceiling && row < floor;
+  short cellPair;
+  chtype ch = ' ';
+  if (covered >= 1 - EDGE_MIN) {
+    if (drawnAsWall)
+      return;
+    cellPair = pair;
+  } else if (covered <= EDGE_MIN) {
+    if (!drawnAsWall)
+      return;
+    cellPair = row < h / 2 ? BLACK_ON_BLACK : floorShade(row, h);
+  } else {
+    int background = 0;
+    if (row >= h / 2) {
+      int shade = floorShade(row, h) - FLOOR_SHADE_START;
+      background = 1 + shade * (AA_BACKGROUNDS - 1) / SHADES;
+    }
+    cellPair = EDGE_PAIR_START + background * SHADES +
+               pair - WALL_SHADE_START;
+    ch = stippleChar;
+  }
+
+  putCell(v, row, col, ch, cellPair);
+}
+
+void resolveAA(struct view *v, int w, int h) {
+  for (int col = 0; col < w; col++) {
+    const struct rayHit *hits = subrays + col * AA_SUB;
+    drawCells(v, col, h, hits);
+
+    short pair = shadeForHit(hits);
+    if (pair == BLACK_ON_BLACK)
+      continue;
+
+    bundle distance;
+    for (int i = 0; i < AA_SUB; i++)
+      distance[i] = hits[i].distance;
+    bundle top = h / 2.0f - (float) h / distance;
+    bundle bottom = (float) h - top;
+
+    int ceiling = wallCeiling(h, hits[0].distance);
+    int floor = h - ceiling;
+    for (int row = ceiling - 1; row <= ceiling; row++)
+      drawEdge(v, col, row, h, ceiling, floor, pair,
+               coverage(top, bottom, row));
+    for (int row = floor - 1; row <= floor; row++)
+      drawEdge(v, col, row, h, ceiling, floor, pair,
+               coverage(top, bottom, row));
+  }
+}
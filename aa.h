@@ -0,0 +1,42 @@
+/* Anti-aliased wall edges.
+ *
+ * With AA on the renderers cast AA_SUB subrays per
+ * screen column. Each column is drawn from its
+ * first subray as usual, then the cells where the
+ * wall starts and ends are redrawn from how much of
+ * them all the subrays' walls cover, as a stipple
+ * of wall over ceiling or floor.
+ */
+
+#ifndef AA_H
+#define AA_H
+
+#include <stdbool.h>
+
+#include "doom_text.h"
+
+// subrays per column, 2 or 4
+#define AA_SUB 4
+
+// backgrounds an edge can be blended over: black
+// then a few steps of the floor
+#define AA_BACKGROUNDS 5
+
+// wall on background color pairs, after the floor
+#define EDGE_PAIR_START (FLOOR_SHADE_START + SHADES)
+
+// defines the edge color pairs, false if the
+// terminal does not have enough of them
+bool initEdgePairs();
+
+// points the subray buffer at this threads scratch,
+// which has room for any view on the screen
+void resizeAA();
+
+// stores the hit of one subray, col is in subrays
+void recordSubray(int col, const struct rayHit *hit);
+
+// draws every column of a view from its subrays
+void resolveAA(struct view *v, int w, int h);
+
+#endif
@@ -0,0 +1,62 @@
+/* Frame arena allocator. */
+
+#include <stdlib.h>
+
+#include "arena.h"
+
+// a block from the heap for a frame that overran
+struct arenaSpill {
+  struct arenaSpill *next;
+};
+
+struct arena frameArena;
+
+static size_t alignUp(size_t n) {
+  return (n + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+}
+
+void initArena(struct arena *a, size_t size) {
+  a->size = alignUp(size);
+  a->base = aligned_alloc(ARENA_ALIGN, a->size);
+  a->used = a->peak = 0;
+  a->spills = NULL;
+  a->grows = 0;
+}
+
+void *arenaAlloc(struct arena *a, size_t size) {
+  size = alignUp(size);
+  a->peak += size;
+  if (a->used + size <= a->size) {
+    void *p = a->base + a->used;
+    a->used += size;
+    return p;
+  }
+
+  // the block header takes one aligned slot
+  struct arenaSpill *spill = aligned_alloc(ARENA_ALIGN, ARENA_ALIGN + size);
+  spill->next = a->spills;
+  a->spills = spill;
+  return (uint8_t *) spill + ARENA_ALIGN;
+}
+
+void resetArena(struct arena *a) {
+  while (a->spills) {
+    struct arenaSpill *next = a->spills->next;
+    free(a->spills);
+    a->spills = next;
+  }
+  if (a->peak > a->size) {
+    free(a->base);
+    a->size = alignUp(a->peak + a->peak / 2);
+    a->base = aligned_alloc(ARENA_ALIGN, a->size);
+    a->grows++;
+  }
+  a->used = a->peak = 0;
+}
+
+void freeArena(struct arena *a) {
+  resetArena(a);
+  free(a->base);
+  a->base = NULL;
+  a->size = 0;
+}
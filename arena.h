@@ -0,0 +1,54 @@
+/* Frame arena.
+ *
+ * Scratch memory that only lives for one frame comes
+ * from frameArena, which main resets at the top of
+ * every pass of the game loop, so a frame costs a
+ * pointer bump per buffer rather than a malloc.
+ * Memory that lives longer (framebuffers, per thread
+ * ray buffers, encode buffers) is sized when the
+ * screen is, not every frame.
+ *
+ * A frame that needs more than the arena holds gets
+ * the rest from the heap, and the next reset grows
+ * the arena to the most any frame has used, so a
+ * steady frame loop allocates nothing (see audit.h).
+ * Only the main thread may use frameArena.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// every block starts on a cache line
+#define ARENA_ALIGN 64
+
+// bytes frameArena starts with
+#define FRAME_ARENA_SIZE (256 * 1024)
+
+struct arenaSpill;
+
+struct arena {
+  uint8_t *base;
+  size_t size, used;
+  size_t peak;            // most a frame has asked for
+  struct arenaSpill *spills;
+  int grows;              // times it had to grow
+};
+
+extern struct arena frameArena;
+
+void initArena(struct arena *a, size_t size);
+
+// size bytes, ARENA_ALIGN aligned and uninitialised,
+// valid until the next resetArena
+void *arenaAlloc(struct arena *a, size_t size);
+
+// frees everything at once, growing the arena if the
+// last frame did not fit
+void resetArena(struct arena *a);
+
+void freeArena(struct arena *a);
+
+#endif
@@ -0,0 +1,128 @@
+/* Allocation audit. Built with ALLOC_AUDIT for
+ * app-audit, where the allocator is interposed
+ * rather than wrapped so that allocations inside
+ * libraries count too; each hook counts and passes
+ * on to glibc. Otherwise every call is empty.
+ */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audit.h"
+#include "term.h"
+#include "clock.h"
+
+#ifdef ALLOC_AUDIT
+
+// what glibc's own names for its allocator are
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+
+static atomic_bool steady;
+static atomic_long steadyAllocations;
+static void *_Atomic firstCaller;
+static atomic_long allocations;
+
+static int quietFrames;
+static long steadyFrames;
+static double steadySeconds, worstSeconds, lastFrame;
+
+static void counted(void *caller) {
+  atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+  if (!atomic_load_explicit(&steady, memory_order_relaxed))
+    return;
+  void *none = NULL;
+  atomic_compare_exchange_strong(&firstCaller, &none, caller);
+  atomic_fetch_add(&steadyAllocations, 1);
+}
+
+void *malloc(size_t size) {
+  counted(__builtin_return_address(0));
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+  counted(__builtin_return_address(0));
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *p, size_t size) {
+  counted(__builtin_return_address(0));
+  return __libc_realloc(p, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+  counted(__builtin_return_address(0));
+  return __libc_memalign(alignment, size);
+}
+
+// *p is only set on success, as POSIX asks
+int posix_memalign(void **p, size_t alignment, size_t size) {
+  counted(__builtin_return_address(0));
+  if (alignment % sizeof(void *) || alignment & (alignment - 1))
+    return EINVAL;
+  void *q = __libc_memalign(alignment, size);
+  if (!q)
+    return ENOMEM;
+  *p = q;
+  return 0;
+}
+
+void auditFrame(bool changed) {
+  double t = now();
+  if (atomic_load(&steady)) {
+    if (atomic_load(&steadyAllocations)) {
+      atomic_store(&steady, false);
+      stopTerm();
+      // as an offset into its object, for addr2line
+      void *caller = atomic_load(&firstCaller);
+      Dl_info info = { 0 };
+      dladdr(caller, &info);
+      fprintf(stderr, "audit: %ld allocations in a steady frame, the first "
+              "from %s+%#lx\n", atomic_load(&steadyAllocations),
+              info.dli_fname ? info.dli_fname : "?",
+              (long) ((char *) caller - (char *) info.dli_fbase));
+      exit(1);
+    }
+    steadyFrames++;
+    steadySeconds += t - lastFrame;
+    if (t - lastFrame > worstSeconds)
+      worstSeconds = t - lastFrame;
+  }
+  quietFrames = changed ? 0 : quietFrames + 1;
+  atomic_store(&steady, quietFrames >= AUDIT_WARMUP);
+  lastFrame = t;
+}
+
+void auditChanged() {
+  quietFrames = 0;
+  atomic_store(&steady, false);
+}
+
+void auditReport() {
+  atomic_store(&steady, false);
+  fprintf(stderr, "audit: %ld allocations, none in %ld steady frames, "
+          "frame mean %.0fus worst %.0fus\n", atomic_load(&allocations),
+          steadyFrames, steadyFrames ? steadySeconds / steadyFrames * 1e6 : 0,
+          worstSeconds * 1e6);
+}
+
+#else
+
+void auditFrame(bool changed) {
+  (void) changed;
+}
+
+void auditChanged() {}
+
+void auditReport() {}
+
+#endif
@@ -0,0 +1,38 @@
+/* Allocation audit.
+ *
+ * `make audit` builds app-audit, whose malloc,
+ * calloc, realloc and aligned allocations are
+ * counted on every thread, ncurses included. Once
+ * the game loop has gone AUDIT_WARMUP frames without
+ * a change (a key, a resize, or anything that calls
+ * auditChanged), every frame is steady, and the
+ * first allocation in a steady frame ends the game
+ * with the address that made it (see addr2line).
+ * On the way out it reports how many steady frames
+ * there were and how long they took, so allocation
+ * jitter shows up as a gap between mean and worst.
+ *
+ * In the normal build these do nothing.
+ */
+
+#ifndef AUDIT_H
+#define AUDIT_H
+
+#include <stdbool.h>
+
+// frames after a change before allocations count
+#define AUDIT_WARMUP 30
+
+// checks the frame before and starts the next one
+// of the game loop, changed if it has input or a
+// resize to deal with
+void auditFrame(bool changed);
+
+// marks the current frame as changed, for rare
+// events that are allowed to allocate
+void auditChanged();
+
+// prints what the audit saw
+void auditReport();
+
+#endif
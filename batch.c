@@ -0,0 +1,194 @@
+/* Batch renderer for --batch. */
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doom_text.h"
+#include "pool.h"
+#include "batch.h"
+#include "fixed.h"
+#include "term.h"
+#include "clock.h"
+
+// color pairs with a known color
+#define PAIRS (FLOOR_SHADE_START + SHADES)
+
+struct pose {
+  struct camera cam;
+  int w, h;
+  int index;              // line order, names the file
+};
+
+struct batchJob {
+  struct pose *poses;
+  int count;
+  const char *outDir;
+  bool cells;
+  atomic_int failed;
+};
+
+// background of each color pair as r, g, b
+static uint8_t palette[PAIRS][3];
+
+// per worker cells and encoded file, grown to fit
+static __thread chtype *cells;
+static __thread int cellsSize;
+static __thread uint8_t *out;
+static __thread size_t outSize;
+
+// the background of every pair main defined, black
+// for the rest
+static void buildPalette() {
+  for (int pair = 0; pair < PAIRS; pair++) {
+    short fg, bg, r, g, b;
+    if (!pairContent(pair, &fg, &bg) || !colorContent(bg, &r, &g, &b))
+      continue;
+    palette[pair][0] = r * 255 / 1000;
+    palette[pair][1] = g * 255 / 1000;
+    palette[pair][2] = b * 255 / 1000;
+  }
+}
+
+// reads the pose file, returns how many poses or -1
+static int readPoses(const char *path, struct pose **poses) {
+  FILE *in = fopen(path, "r");
+  if (!in) {
+    perror(path);
+    return -1;
+  }
+  int count = 0, size = 0, lineNumber = 0;
+  char line[256];
+  *poses = NULL;
+  while (fgets(line, sizeof(line), in)) {
+    lineNumber++;
+    char *start = line + strspn(line, " \t");
+    if (*start == '#' || *start == '\n' || *start == '\0')
+      continue;
+    struct pose p;
+    if (sscanf(start, "%f %f %f %f %d %d", &p.cam.x, &p.cam.y, &p.cam.a,
+               &p.cam.fov, &p.w, &p.h) != 6 ||
+        p.w < 1 || p.h < 1 || p.w > BATCH_MAX_SIZE || p.h > BATCH_MAX_SIZE ||
+        !(p.cam.x >= 0 && p.cam.x < mapWidth) ||
+        !(p.cam.y >= 0 && p.cam.y < mapHeight)) {
+      fprintf(stderr, "%s:%d: expected x y angle fov w h, x and y inside "
+              "the %dx%d map\n", path, lineNumber, mapWidth, mapHeight);
+      fclose(in);
+      free(*poses);
+      return -1;
+    }
+    if (count == size) {
+      size = size ? size * 2 : 1024;
+      *poses = realloc(*poses, size * sizeof(struct pose));
+    }
+    p.index = count;
+    (*poses)[count++] = p;
+  }
+  fclose(in);
+  return count;
+}
+
+static int tileOf(const struct pose *p) {
+  int tileX = (int) floorf(p->cam.x / BATCH_TILE);
+  int tileY = (int) floorf(p->cam.y / BATCH_TILE);
+  return tileY * (mapWidth / BATCH_TILE + 1) + tileX;
+}
+
+// by tile, then by angle so neighbouring views share
+// the walls they look at
+static int byTile(const void *a, const void *b) {
+  const struct pose *p = a, *q = b;
+  int tileP = tileOf(p), tileQ = tileOf(q);
+  if (tileP != tileQ)
+    return (tileP > tileQ) - (tileP < tileQ);
+  return (p->cam.a > q->cam.a) - (p->cam.a < q->cam.a);
+}
+
+// encodes the cells of a pose into out, returns the
+// length
+static size_t encode(const struct pose *p, bool raw) {
+  size_t pixels = (size_t) p->w * p->h;
+  size_t need = 32 + pixels * (raw ? sizeof(uint32_t) : 3);
+  if (need > outSize) {
+    outSize = need;
+    out = realloc(out, outSize);
+  }
+  size_t n = sprintf((char *) out, "%s %d %d\n%s", raw ? "DTC1" : "P6",
+                     p->w, p->h, raw ? "" : "255\n");
+  if (raw) {
+    uint32_t *cell = (uint32_t *) (out + n);
+    for (size_t i = 0; i < pixels; i++)
+      cell[i] = cells[i];
+    return n + pixels * sizeof(uint32_t);
+  }
+  uint8_t *pixel = out + n;
+  for (size_t i = 0; i < pixels; i++, pixel += 3) {
+    int pair = PAIR_NUMBER(cells[i]);
+    if (pair < PAIRS) {
+      memcpy(pixel, palette[pair], 3);
+    } else {
+      memset(pixel, 0, 3);
+    }
+  }
+  return n + pixels * 3;
+}
+
+// renders and writes one group of poses, runs on
+// the pool
+static void renderGroup(int index, void *arg) {
+  struct batchJob *job = arg;
+  int first = index * BATCH_GROUP;
+  int last = first + BATCH_GROUP < job->count ? first + BATCH_GROUP :
+                                                job->count;
+  for (int i = first; i < last; i++) {
+    const struct pose *p = &job->poses[i];
+    if (p->w * p->h > cellsSize) {
+      cellsSize = p->w * p->h;
+      cells = realloc(cells, cellsSize * sizeof(chtype));
+    }
+    for (int c = 0; c < p->w * p->h; c++)
+      cells[c] = ' ' | COLOR_PAIR(TEXT);
+    struct view v = { p->cam, 0, 0, p->w, p->h, cells, p->w, NULL, NULL };
+    if (fixedMath)
+      renderGridFixed(&v, p->w, p->h);
+    else
+      renderGrid(&v, p->w, p->h);
+
+    size_t n = encode(p, job->cells);
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%06d.%s", job->outDir, p->index,
+             job->cells ? "cells" : "ppm");
+    FILE *file = fopen(path, "wb");
+    if (!file || fwrite(out, 1, n, file) != n) {
+      // the first failure is reason enough to say why
+      if (atomic_fetch_add(&job->failed, 1) == 0)
+        perror(path);
+    }
+    if (file)
+      fclose(file);
+  }
+}
+
+int runBatch(const char *posesPath, const char *outDir, bool cells) {
+  struct batchJob job = { NULL, 0, outDir, cells, 0 };
+  job.count = readPoses(posesPath, &job.poses);
+  if (job.count < 0)
+    return 1;
+
+  buildPalette();
+  qsort(job.poses, job.count, sizeof(struct pose), byTile);
+  startPool();
+  double start = now();
+  runPool(renderGroup, (job.count + BATCH_GROUP - 1) / BATCH_GROUP, &job);
+  double seconds = now() - start;
+  stopPool();
+
+  int failed = atomic_load(&job.failed);
+  fprintf(stderr, "%d poses in %.3fs, %.0f frames/minute%s\n", job.count,
+          seconds, seconds > 0 ? job.count / seconds * 60 : 0.0,
+          failed ? ", some could not be written" : "");
+  free(job.poses);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,46 @@
+/* Batch rendering.
+ *
+ * With --batch POSES --out DIR the game renders a
+ * list of poses without a terminal, for building
+ * image datasets. POSES is a text file with one pose
+ * a line,
+ *
+ *   x y angle fov w h
+ *
+ * (blank lines and lines starting with # are
+ * skipped), and pose n of the file is written to
+ * DIR/n.ppm, numbered from 0 and padded to six
+ * digits. Each cell becomes one pixel in the color
+ * of its background. With --cells DIR/n.cells gets
+ * the raw cells instead: the line "DTC1 w h" and
+ * then w * h 32 bit chtypes in host byte order,
+ * whose pairs are the ones main sets up.
+ *
+ * Poses are sorted by the map tile they stand in
+ * and handed to the worker pool BATCH_GROUP at a
+ * time, so one worker renders poses close together
+ * and finds the map, textures and lightmap around
+ * them already in its cache. Every pose goes through
+ * renderGrid, the same ray caster the game uses.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+
+// poses one pool job renders
+#define BATCH_GROUP 64
+
+// side of the map tiles poses are sorted by
+#define BATCH_TILE 8
+
+// largest view a pose can ask for
+#define BATCH_MAX_SIZE 4096
+
+// renders every pose in posesPath into outDir as
+// images, or as cell dumps if cells, and returns
+// the exit status
+int runBatch(const char *posesPath, const char *outDir, bool cells);
+
+#endif
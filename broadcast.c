@@ -0,0 +1,415 @@
+/* Spectator broadcast server. Frames are encoded
+ * into reference counted packets, at most one diff
+ * and one keyframe a frame however many spectators
+ * there are, and every spectator keeps a queue of
+ * the packets it still has to be sent.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "broadcast.h"
+#include "audit.h"
+#include "term.h"
+
+// color pairs with a known escape sequence
+#define PAIRS 256
+
+// packets queued for one spectator before it is
+// dropped back to a keyframe, whatever their size
+#define MAX_QUEUED 32
+
+// starts a keyframe: cancel any half sent escape,
+// reset colors, hide the cursor and clear
+#define KEYFRAME_START "\x18\x1b[0m\x1b[?25l\x1b[2J"
+
+// back to the default colors
+#define SGR_RESET "\x1b[0m"
+
+// what ACS_CKBOARD is sent as, a UTF-8 shade block
+#define CKBOARD_UTF8 "\xe2\x96\x92"
+
+// most one cell can take to encode: a cursor move,
+// a color and a character
+#define CELL_BYTES (24 + 48 + 3)
+
+// smallest packet allocated
+#define MIN_PACKET 4096
+
+// packets kept for reuse once no queue holds them,
+// so a steady frame allocates nothing
+#define MAX_SPARE 8
+
+// one encoded frame, shared by every queue it is in
+struct packet {
+  int refs;
+  size_t length;
+  size_t capacity;
+  char data[];
+};
+
+struct spectator {
+  int fd;
+  struct packet *queue[MAX_QUEUED];
+  int head, count;
+  size_t queued;      // bytes of every queued packet
+  size_t sent;        // bytes of the head packet already sent
+  bool needsKeyframe;
+  int resyncs;
+};
+
+static int listener = -1;
+static char *socketPath;
+static struct spectator spectators[MAX_SPECTATORS];
+static int numSpectators;
+
+// escape sequence that selects each color pair
+static char sgr[PAIRS][48];
+
+// the last frame sent, diffs are against it
+static chtype *previous;
+static int previousW, previousH;
+
+// encode buffer, reused every frame
+static char *out;
+static size_t outLength, outSize;
+
+static struct packet *spare[MAX_SPARE];
+static int numSpare;
+
+static size_t frameDiffBytes;
+static int totalResyncs;
+
+int startBroadcast(const char *path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "%s: socket path too long\n", path);
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+
+  listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listener < 0) {
+    perror("socket");
+    return -1;
+  }
+  unlink(path);
+  if (bind(listener, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+      listen(listener, 16) < 0) {
+    perror(path);
+    close(listener);
+    listener = -1;
+    return -1;
+  }
+  socketPath = strdup(path);
+  return 0;
+}
+
+// escape sequence color for a palette color, the
+// terminal default when there is none
+static int colorSGR(char *s, size_t size, short color, int base) {
+  short r, g, b;
+  if (color < 0 || !colorContent(color, &r, &g, &b))
+    return snprintf(s, size, ";%d", base + 9);
+  return snprintf(s, size, ";%d;2;%d;%d;%d", base + 8,
+                  r * 255 / 1000, g * 255 / 1000, b * 255 / 1000);
+}
+
+void broadcastPalette() {
+  for (int pair = 0; pair < PAIRS; pair++) {
+    short fg, bg;
+    char *s = sgr[pair];
+    int n = snprintf(s, sizeof(sgr[pair]), "\x1b[0");
+    if (pair != TEXT && pair < termPairs() && pairContent(pair, &fg, &bg)) {
+      n += colorSGR(s + n, sizeof(sgr[pair]) - n, fg, 30);
+      n += colorSGR(s + n, sizeof(sgr[pair]) - n, bg, 40);
+    }
+    snprintf(s + n, sizeof(sgr[pair]) - n, "m");
+  }
+}
+
+// a packet for length bytes, the smallest spare one
+// that fits if any. new ones are rounded up to a
+// power of two so frames of about the same size can
+// share them
+static struct packet *newPacket(size_t length) {
+  int best = -1;
+  for (int i = 0; i < numSpare; i++)
+    if (spare[i]->capacity >= length &&
+        (best < 0 || spare[i]->capacity < spare[best]->capacity))
+      best = i;
+  struct packet *p;
+  if (best >= 0) {
+    p = spare[best];
+    spare[best] = spare[--numSpare];
+  } else {
+    size_t capacity = MIN_PACKET;
+    while (capacity < length)
+      capacity *= 2;
+    p = malloc(sizeof(struct packet) + capacity);
+    p->capacity = capacity;
+  }
+  p->refs = 0;
+  p->length = length;
+  return p;
+}
+
+// keeps the biggest spares
+static void recycle(struct packet *p) {
+  int smallest = 0;
+  for (int i = 1; i < numSpare; i++)
+    if (spare[i]->capacity < spare[smallest]->capacity)
+      smallest = i;
+  if (numSpare < MAX_SPARE) {
+    spare[numSpare++] = p;
+  } else if (spare[smallest]->capacity < p->capacity) {
+    free(spare[smallest]);
+    spare[smallest] = p;
+  } else {
+    free(p);
+  }
+}
+
+static void emit(const char *s, size_t n) {
+  if (outLength + n > outSize) {
+    outSize = (outLength + n) * 2;
+    out = realloc(out, outSize);
+  }
+  memcpy(out + outLength, s, n);
+  outLength += n;
+}
+
+// encodes the cells that changed since the last
+// frame, or every cell for a keyframe. NULL when
+// there is nothing to send
+static struct packet *encode(const chtype *cells, int w, int h,
+                             bool keyframe) {
+  outLength = 0;
+  if (keyframe)
+    emit(KEYFRAME_START, sizeof(KEYFRAME_START) - 1);
+
+  int cursorRow = -1, cursorCol = -1;
+  int pair = -1;
+  for (int row = 0; row < h; row++) {
+    for (int col = 0; col < w; col++) {
+      chtype cell = cells[row * w + col];
+      if (!keyframe && cell == previous[row * w + col])
+        continue;
+
+      char move[24];
+      if (row != cursorRow || col != cursorCol)
+        emit(move, snprintf(move, sizeof(move), "\x1b[%d;%dH",
+                            row + 1, col + 1));
+      // a pair without a sequence shows in the default
+      // colors, PAIRS stands for all of them
+      int cellPair = PAIR_NUMBER(cell);
+      if (cellPair >= PAIRS)
+        cellPair = PAIRS;
+      if (cellPair != pair) {
+        if (cellPair == PAIRS)
+          emit(SGR_RESET, sizeof(SGR_RESET) - 1);
+        else
+          emit(sgr[cellPair], strlen(sgr[cellPair]));
+        pair = cellPair;
+      }
+      if (cell & A_ALTCHARSET) {
+        emit(CKBOARD_UTF8, sizeof(CKBOARD_UTF8) - 1);
+      } else {
+        char ch = cell & A_CHARTEXT;
+        emit(&ch, 1);
+      }
+      cursorRow = row;
+      cursorCol = col + 1;
+    }
+  }
+  if (outLength == 0)
+    return NULL;
+
+  struct packet *p = newPacket(outLength);
+  memcpy(p->data, out, outLength);
+  return p;
+}
+
+static void release(struct packet *p) {
+  if (--p->refs == 0)
+    recycle(p);
+}
+
+static size_t backlog(const struct spectator *s) {
+  return s->queued - s->sent;
+}
+
+static void enqueue(struct spectator *s, struct packet *p) {
+  p->refs++;
+  s->queue[(s->head + s->count++) % MAX_QUEUED] = p;
+  s->queued += p->length;
+}
+
+// drops every queued packet, except one that is
+// half sent as cutting it short would garble the
+// spectators terminal
+static void dropQueue(struct spectator *s, bool all) {
+  int keep = s->sent > 0 && !all ? 1 : 0;
+  for (int i = keep; i < s->count; i++) {
+    struct packet *p = s->queue[(s->head + i) % MAX_QUEUED];
+    s->queued -= p->length;
+    release(p);
+  }
+  s->count = keep;
+  if (keep == 0)
+    s->sent = 0;
+}
+
+// sends as much as the socket takes without
+// blocking, false once the spectator has gone
+static bool flush(struct spectator *s) {
+  while (s->count > 0) {
+    struct packet *p = s->queue[s->head];
+    ssize_t n = send(s->fd, p->data + s->sent, p->length - s->sent,
+                     MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    s->sent += n;
+    if (s->sent == p->length) {
+      s->queued -= p->length;
+      s->sent = 0;
+      release(p);
+      s->head = (s->head + 1) % MAX_QUEUED;
+      s->count--;
+    }
+  }
+  return true;
+}
+
+static void acceptSpectators() {
+  while (1) {
+    int fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+      return;
+    if (numSpectators == MAX_SPECTATORS) {
+      close(fd);
+      continue;
+    }
+    struct spectator *s = &spectators[numSpectators++];
+    memset(s, 0, sizeof(*s));
+    s->fd = fd;
+    s->needsKeyframe = true;
+    auditChanged();
+  }
+}
+
+void broadcastFrame(const chtype *cells, int w, int h) {
+  if (listener < 0)
+    return;
+  acceptSpectators();
+
+  bool resized = w != previousW || h != previousH;
+  if (resized) {
+    free(previous);
+    previous = malloc(w * h * sizeof(chtype));
+    previousW = w;
+    previousH = h;
+
+    // big enough for any frame, so encoding never
+    // has to grow it
+    free(out);
+    outSize = sizeof(KEYFRAME_START) + (size_t) w * h * CELL_BYTES;
+    out = malloc(outSize);
+  }
+
+  // work out who needs what first, so each kind of
+  // packet is encoded at most once
+  bool wantDiff = false, wantKeyframe = false;
+  for (int i = 0; i < numSpectators; i++) {
+    struct spectator *s = &spectators[i];
+    if (!s->needsKeyframe &&
+        (backlog(s) > BROADCAST_BACKLOG || s->count == MAX_QUEUED)) {
+      s->needsKeyframe = true;
+      s->resyncs++;
+      totalResyncs++;
+      auditChanged();
+    }
+    if (resized)
+      s->needsKeyframe = true;
+    if (s->needsKeyframe)
+      wantKeyframe = true;
+    else
+      wantDiff = true;
+  }
+
+  struct packet *diff = wantDiff ? encode(cells, w, h, false) : NULL;
+  struct packet *keyframe = wantKeyframe ? encode(cells, w, h, true) : NULL;
+  frameDiffBytes = diff ? diff->length : 0;
+  memcpy(previous, cells, w * h * sizeof(chtype));
+
+  for (int i = 0; i < numSpectators; i++) {
+    struct spectator *s = &spectators[i];
+    if (s->needsKeyframe) {
+      dropQueue(s, false);
+      s->needsKeyframe = false;
+      enqueue(s, keyframe);
+    } else if (diff) {
+      enqueue(s, diff);
+    }
+  }
+  if (diff && diff->refs == 0)
+    recycle(diff);
+  if (keyframe && keyframe->refs == 0)
+    recycle(keyframe);
+
+  for (int i = 0; i < numSpectators; i++) {
+    if (!flush(&spectators[i])) {
+      dropQueue(&spectators[i], true);
+      close(spectators[i].fd);
+      spectators[i--] = spectators[--numSpectators];
+    }
+  }
+}
+
+void broadcastReport(struct broadcastStats *stats, char *report,
+                     size_t size) {
+  stats->spectators = numSpectators;
+  stats->diffBytes = frameDiffBytes;
+  stats->maxBacklog = 0;
+  stats->resyncs = totalResyncs;
+  for (int i = 0; i < numSpectators; i++)
+    if (backlog(&spectators[i]) > stats->maxBacklog)
+      stats->maxBacklog = backlog(&spectators[i]);
+
+  int n = snprintf(report, size, "Backlog KB/resyncs:");
+  for (int i = 0; i < numSpectators && n < (int) size; i++)
+    n += snprintf(report + n, size - n, " %zu/%d",
+                  backlog(&spectators[i]) / 1024, spectators[i].resyncs);
+}
+
+void stopBroadcast() {
+  if (listener < 0)
+    return;
+  for (int i = 0; i < numSpectators; i++) {
+    dropQueue(&spectators[i], true);
+    close(spectators[i].fd);
+  }
+  numSpectators = 0;
+  close(listener);
+  listener = -1;
+  unlink(socketPath);
+  free(socketPath);
+  free(previous);
+  free(out);
+  while (numSpare)
+    free(spare[--numSpare]);
+  previous = NULL;
+  out = NULL;
+  outSize = 0;
+  previousW = previousH = 0;
+}
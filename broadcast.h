@@ -0,0 +1,55 @@
+/* Spectator broadcast.
+ *
+ * With --broadcast PATH the game listens on a Unix
+ * socket and streams every frame to whoever
+ * connects, as plain ANSI terminal output (e.g.
+ * `nc -U PATH`). Each frame is encoded once as a
+ * diff against the last one and that same buffer
+ * is queued for every spectator. A spectator that
+ * falls too far behind has its queue dropped and
+ * gets a keyframe (the whole screen) instead, so
+ * it never holds up the game or anyone else.
+ */
+
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <stddef.h>
+
+#include "doom_text.h"
+
+// most spectators at once
+#define MAX_SPECTATORS 64
+
+// bytes queued for one spectator before it is
+// dropped back to a keyframe
+#define BROADCAST_BACKLOG (256 * 1024)
+
+// what the spectators cost this frame
+struct broadcastStats {
+  int spectators;
+  size_t diffBytes;
+  size_t maxBacklog;
+  int resyncs;
+};
+
+// starts listening on path, -1 if that failed
+int startBroadcast(const char *path);
+
+// takes the colors of every pair from ncurses, call
+// once the color pairs are defined
+void broadcastPalette();
+
+// accepts new spectators, encodes the w x h frame
+// and sends whatever each spectator can take
+void broadcastFrame(const chtype *cells, int w, int h);
+
+// this frames totals, and each spectators backlog
+// in KB and resync count written as text into report
+void broadcastReport(struct broadcastStats *stats, char *report,
+                     size_t size);
+
+// disconnects everyone and removes the socket
+void stopBroadcast();
+
+#endif
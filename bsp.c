@@ -0,0 +1,225 @@
+/* Front to back BSP renderer.
+ *
+ * The tree is walked near side first, so the
+ * first seg to reach a column is the one that
+ * is seen there. A bitmap tracks which columns
+ * are already solid; subtrees whose bounding box
+ * only covers solid columns are skipped and the
+ * walk stops once every column is solid, so the
+ * cost of a frame follows what is on screen
+ * rather than the size of the map.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "doom_text.h"
+#include "bsp.h"
+#include "resize.h"
+#include "fastmath.h"
+
+// slack when checking a ray lands inside a seg
+#define SEG_EPSILON 1e-4f
+
+// per frame state, one per rendering thread
+static __thread struct view *view;
+static __thread const struct camera *eye;
+static __thread uint64_t *solid;
+static __thread int solidCount;
+static __thread float *rayX;
+static __thread float *rayY;
+static __thread int columns;
+static __thread struct bspStats *counters;
+
+static bool isSolidColumn(int col) {
+  return solid[col >> 6] >> (col & 63) & 1;
+}
+
+static void markSolid(int col) {
+  solid[col >> 6] |= (uint64_t) 1 << (col & 63);
+  solidCount++;
+}
+
+// normalises an angle into (-pi, pi]
+static float wrapAngle(float d) {
+  d = fmodf(d, 2 * M_PI);
+  if (d > M_PI) d -= 2 * M_PI;
+  if (d <= -M_PI) d += 2 * M_PI;
+  return d;
+}
+
+// angle of a point relative to the view direction, in (-pi, pi]
+static float viewAngle(float x, float y) {
+  return wrapAngle(fastAtan2(y - eye->y, x - eye->x) - eye->a);
+}
+
+// screen column a relative angle lands on, unclamped
+static float columnOf(float angle) {
+  return (angle + eye->fov / 2) / eye->fov * columns;
+}
+
+// turns the angular span of a set of points into
+// column ranges, returns how many there are. the
+// points must span less than half a turn, so
+// everything is measured from the first one
+static int columnRanges(const float *angles, int count, int ranges[3][2]) {
+  float lo = 0;
+  float hi = 0;
+  for (int i = 1; i < count; i++) {
+    float d = wrapAngle(angles[i] - angles[0]);
+    if (d < lo) lo = d;
+    if (d > hi) hi = d;
+  }
+  lo += angles[0];
+  hi += angles[0];
+
+  // the span may poke out past +-pi, so try it a
+  // turn either way as well
+  int numRanges = 0;
+  for (int turn = -1; turn <= 1; turn++) {
+    float shift = turn * 2 * M_PI;
+    int c0 = floorf(columnOf(lo + shift)) - 1;
+    int c1 = ceilf(columnOf(hi + shift)) + 1;
+    if (c0 < 0) c0 = 0;
+    if (c1 > columns) c1 = columns;
+    if (c0 < c1) {
+      ranges[numRanges][0] = c0;
+      ranges[numRanges++][1] = c1;
+    }
+  }
+  return numRanges;
+}
+
+// could anything inside the box still show up on screen
+static bool boxVisible(const int16_t *bbox) {
+  if (eye->x >= bbox[0] && eye->x <= bbox[2] &&
+      eye->y >= bbox[1] && eye->y <= bbox[3])
+    return true;
+
+  float angles[4] = {
+    viewAngle(bbox[0], bbox[1]), viewAngle(bbox[2], bbox[1]),
+    viewAngle(bbox[0], bbox[3]), viewAngle(bbox[2], bbox[3])
+  };
+  int ranges[3][2];
+  int numRanges = columnRanges(angles, 4, ranges);
+  for (int i = 0; i < numRanges; i++)
+    for (int col = ranges[i][0]; col < ranges[i][1]; col++)
+      if (!isSolidColumn(col))
+        return true;
+  return false;
+}
+
+static void drawSeg(const struct bspSeg *seg, int h) {
+  counters->segs++;
+
+  // only the side a seg faces is drawn, standing
+  // right on the line still counts as in front
+  bool vertical = seg->face == FACE_EAST || seg->face == FACE_WEST;
+  float line = vertical ? seg->x0 : seg->y0;
+  float viewer = vertical ? eye->x : eye->y;
+  if ((seg->face == FACE_EAST || seg->face == FACE_SOUTH) ?
+      viewer < line : viewer > line)
+    return;
+
+  // standing on the line the seg spans half the view,
+  // so just try every column
+  int ranges[3][2] = { { 0, columns } };
+  int numRanges = 1;
+  if (viewer != line) {
+    float angles[2] = {
+      viewAngle(seg->x0, seg->y0), viewAngle(seg->x1, seg->y1)
+    };
+    numRanges = columnRanges(angles, 2, ranges);
+  }
+
+  float lo = vertical ? seg->y0 : seg->x0;
+  float hi = vertical ? seg->y1 : seg->x1;
+  for (int i = 0; i < numRanges; i++) {
+    for (int col = ranges[i][0]; col < ranges[i][1]; col++) {
+      if (isSolidColumn(col))
+        continue;
+
+      // the ray has to travel into the face
+      float toward = vertical ? rayX[col] : rayY[col];
+      float across = vertical ? rayY[col] : rayX[col];
+      if ((seg->face == FACE_EAST || seg->face == FACE_SOUTH) ?
+          toward >= 0 : toward <= 0)
+        continue;
+      float dist = (line - viewer) / toward;
+      float at = (vertical ? eye->y : eye->x) + dist * across;
+      if (dist < 0 || at < lo - SEG_EPSILON || at > hi + SEG_EPSILON)
+        continue;
+
+      // what this column cost is every seg tried so far
+      struct rayHit hit = { MAX_DEPTH, -1, -1, 0, 0, counters->segs };
+      if (dist < MAX_DEPTH) {
+        hit.distance = dist;
+        hit.face = seg->face;
+        hit.u = faceU(seg->face, at);
+        if (vertical) {
+          hit.cellX = seg->face == FACE_EAST ? line - 1 : line;
+          hit.cellY = floorf(at);
+        } else {
+          hit.cellX = floorf(at);
+          hit.cellY = seg->face == FACE_SOUTH ? line - 1 : line;
+        }
+      }
+      drawColumn(view, col, h, &hit);
+      markSolid(col);
+    }
+  }
+}
+
+static void walk(const struct level *level, int32_t index, int h) {
+  if (solidCount == columns)
+    return;
+
+  if (index < 0) {
+    const struct bspLeaf *leaf = &level->leaves[~index];
+    for (uint32_t i = 0; i < leaf->numSegs && solidCount < columns; i++)
+      drawSeg(&level->segs[leaf->firstSeg + i], h);
+    return;
+  }
+
+  counters->nodes++;
+  const struct bspNode *node = &level->nodes[index];
+  float viewer = node->axis == 0 ? eye->x : eye->y;
+  int near = viewer < node->value ? 0 : 1;
+
+  if (boxVisible(node->bbox[near]))
+    walk(level, node->child[near], h);
+  if (solidCount < columns && boxVisible(node->bbox[!near]))
+    walk(level, node->child[!near], h);
+}
+
+void renderBSP(struct view *v, const struct level *level, int w, int h,
+               struct bspStats *stats) {
+  view = v;
+  eye = &v->cam;
+  struct scratch *s = threadScratch();
+  solid = s->solid;
+  rayX = s->rayX;
+  rayY = s->rayY;
+  columns = w;
+
+  rayDirections(rayX, rayY, eye->a - eye->fov / 2, eye->fov / w, w);
+
+  memset(solid, 0, ((w + 63) / 64) * sizeof(uint64_t));
+  solidCount = 0;
+  memset(stats, 0, sizeof(*stats));
+  counters = stats;
+
+  if (level->numNodes > 0)
+    walk(level, 0, h);
+  else if (level->numLeaves > 0)
+    walk(level, ~0, h);
+
+  // anything left open looks out of the map
+  struct rayHit none = { MAX_DEPTH, -1, -1, 0, 0, counters->segs };
+  for (int col = 0; col < w && solidCount < w; col++)
+    if (!isSolidColumn(col)) {
+      drawColumn(view, col, h, &none);
+      markSolid(col);
+    }
+}
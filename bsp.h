@@ -0,0 +1,20 @@
+/* Front to back BSP renderer for compiled levels. */
+
+#ifndef BSP_H
+#define BSP_H
+
+#include "doom_text.h"
+#include "level.h"
+
+// per frame counters of how much of the tree was walked
+struct bspStats {
+  int nodes;
+  int segs;
+};
+
+// draws every column of a view by walking the tree
+// front to back until all columns are solid
+void renderBSP(struct view *v, const struct level *level, int w, int h,
+               struct bspStats *stats);
+
+#endif
@@ -0,0 +1,148 @@
+/* castplay - asciicast player for benchmarks.
+ *
+ * Usage: castplay [-r | -t] FILE
+ *
+ * Writes the output of a recording (see record.h)
+ * to stdout as fast as it can, to time a terminal
+ * emulator drawing it, and reports the rate on
+ * stderr. -r plays at the recorded pace instead and
+ * -t feeds the output to the terminal parser in vt.h
+ * rather than stdout, to time the stream alone.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vt.h"
+#include "clock.h"
+
+// appends code point u as UTF-8
+static char *putUTF8(char *out, unsigned u) {
+  if (u < 0x80) {
+    *out++ = u;
+  } else if (u < 0x800) {
+    *out++ = 0xc0 | u >> 6;
+    *out++ = 0x80 | (u & 0x3f);
+  } else {
+    *out++ = 0xe0 | u >> 12;
+    *out++ = 0x80 | (u >> 6 & 0x3f);
+    *out++ = 0x80 | (u & 0x3f);
+  }
+  return out;
+}
+
+// decodes the JSON string starting after the quote at
+// in into out, returns its length or -1 if malformed
+static long readString(const char *in, char *out) {
+  char *start = out;
+  while (*in && *in != '"') {
+    if (*in != '\\') {
+      *out++ = *in++;
+      continue;
+    }
+    in++;
+    switch (*in++) {
+      case 'n': *out++ = '\n'; break;
+      case 'r': *out++ = '\r'; break;
+      case 't': *out++ = '\t'; break;
+      case 'b': *out++ = '\b'; break;
+      case 'f': *out++ = '\f'; break;
+      case 'u': {
+        unsigned u;
+        if (sscanf(in, "%4x", &u) != 1)
+          return -1;
+        out = putUTF8(out, u);
+        in += 4;
+        break;
+      }
+      case '\0': return -1;
+      default: *out++ = in[-1]; break;
+    }
+  }
+  return *in == '"' ? out - start : -1;
+}
+
+int main(int argc, char **argv) {
+  bool realtime = false, parse = false;
+  const char *path = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-r") == 0)
+      realtime = true;
+    else if (strcmp(argv[i], "-t") == 0)
+      parse = true;
+    else
+      path = argv[i];
+  }
+  if (!path || (realtime && parse)) {
+    fprintf(stderr, "usage: %s [-r | -t] FILE\n", argv[0]);
+    return 1;
+  }
+  FILE *in = fopen(path, "r");
+  if (!in) {
+    perror(path);
+    return 1;
+  }
+
+  char *line = NULL;
+  size_t lineSize = 0;
+  int width = 80, height = 24;
+  char *w, *h;
+  if (getline(&line, &lineSize, in) < 0 || !strstr(line, "\"version\": 2") ||
+      !(w = strstr(line, "\"width\":")) || !(h = strstr(line, "\"height\":")) ||
+      sscanf(w, "\"width\": %d", &width) != 1 ||
+      sscanf(h, "\"height\": %d", &height) != 1) {
+    fprintf(stderr, "%s: not an asciicast v2 recording\n", path);
+    return 1;
+  }
+  struct vt vt;
+  if (parse && vtOpen(&vt, width, height) < 0)
+    return 1;
+
+  char *data = NULL;
+  size_t dataSize = 0, bytes = 0;
+  int events = 0;
+  double start = now();
+  ssize_t length;
+  while ((length = getline(&line, &lineSize, in)) > 0) {
+    double time;
+    char type;
+    int offset = 0;
+    if (sscanf(line, "[%lf, \"%c\", \"%n", &time, &type, &offset) != 2 ||
+        !offset || type != 'o')
+      continue;
+    if (dataSize < (size_t) length) {
+      dataSize = length;
+      data = realloc(data, dataSize);
+    }
+    long n = readString(line + offset, data);
+    if (n < 0) {
+      fprintf(stderr, "%s: bad event at %.6f\n", path, time);
+      return 1;
+    }
+
+    if (realtime) {
+      double wait = start + time - now();
+      if (wait > 0) {
+        struct timespec t = { wait, (wait - (long) wait) * 1e9 };
+        nanosleep(&t, NULL);
+      }
+    }
+    if (parse)
+      vtFeed(&vt, data, n);
+    else if (fwrite(data, 1, n, stdout) != (size_t) n)
+      break;
+    bytes += n;
+    events++;
+  }
+  fflush(stdout);
+  double seconds = now() - start;
+  fprintf(stderr, "%d events, %zu bytes in %.3fs, %.1f MB/s, %.0f events/s\n",
+          events, bytes, seconds, bytes / seconds / 1e6, events / seconds);
+  return 0;
+}
@@ -0,0 +1,195 @@
+/* Multiplayer client: input sending, prediction
+ * and reconciliation against server snapshots.
+ */
+
+#define _GNU_SOURCE
+
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "net.h"
+#include "clock.h"
+
+static int sock = -1;
+static int selfId = -1;
+
+// inputs not yet played by the server, ring
+// indexed by sequence, and when each was sent
+static uint8_t pending[NET_MAX_INPUTS];
+static double pendingSent[NET_MAX_INPUTS];
+static uint32_t nextInput = 1;
+static uint32_t lastPlayed;
+
+// snapshots received, for decoding deltas
+static struct snapshot received[NET_HISTORY];
+static uint32_t latestTick;
+
+static double lastSend;
+
+// counters for the current second, and the last
+// full second for reporting
+static double secondStart;
+static int bytesThisSecond, snapshotsThisSecond;
+static struct clientStats stats = { -1, 0, 0, 0, 0 };
+
+int startClient(const char *address) {
+  char host[256];
+  const char *colon = strrchr(address, ':');
+  if (!colon || colon - address >= (int) sizeof(host)) {
+    fprintf(stderr, "%s: expected host:port\n", address);
+    return -1;
+  }
+  memcpy(host, address, colon - address);
+  host[colon - address] = '\0';
+
+  struct addrinfo hints, *info;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  if (getaddrinfo(host, colon + 1, &hints, &info) != 0) {
+    fprintf(stderr, "%s: unknown host\n", address);
+    return -1;
+  }
+  sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  if (sock < 0 || connect(sock, info->ai_addr, info->ai_addrlen) < 0) {
+    perror(address);
+    freeaddrinfo(info);
+    return -1;
+  }
+  freeaddrinfo(info);
+  secondStart = now();
+  return 0;
+}
+
+// sends every input still in flight, so one lost
+// packet costs nothing. says hello until the
+// server has given us an entity
+static void sendInputs() {
+  uint8_t packet[NET_PACKET];
+  size_t length = 1;
+  if (selfId < 0) {
+    packet[0] = PACKET_HELLO;
+  } else {
+    int count = nextInput - lastPlayed - 1;
+    packet[0] = PACKET_INPUT;
+    put32(packet + 1, latestTick);
+    put32(packet + 5, lastPlayed + 1);
+    packet[9] = count;
+    for (int i = 0; i < count; i++)
+      packet[10 + i] = pending[(lastPlayed + 1 + i) % NET_MAX_INPUTS];
+    length = 10 + count;
+  }
+  send(sock, packet, length, 0);
+  lastSend = now();
+}
+
+bool clientInput(int input) {
+  if (selfId < 0 || nextInput - lastPlayed - 1 >= NET_MAX_INPUTS)
+    return false;
+  pending[nextInput % NET_MAX_INPUTS] = input;
+  pendingSent[nextInput % NET_MAX_INPUTS] = now();
+  nextInput++;
+  sendInputs();
+  return true;
+}
+
+// takes in one snapshot, false if it was stale or
+// could not be decoded
+static bool readSnapshot(const uint8_t *packet, ssize_t length) {
+  if (length < 14 || packet[0] != PACKET_SNAPSHOT)
+    return false;
+  uint32_t tick = get32(packet + 1);
+  uint32_t baseTick = get32(packet + 5);
+  uint32_t played = get32(packet + 9);
+  if (tick <= latestTick)
+    return false;
+
+  const struct snapshot *base = NULL;
+  if (baseTick) {
+    base = &received[baseTick % NET_HISTORY];
+    if (base->tick != baseTick)
+      return false;
+  }
+  struct snapshot *s = &received[tick % NET_HISTORY];
+  if (!decodeEntities(packet + 14, length - 14, s, base)) {
+    s->tick = 0;
+    return false;
+  }
+  s->tick = tick;
+  latestTick = tick;
+  selfId = packet[13];
+
+  if (played > lastPlayed && played < nextInput) {
+    float sample = (now() - pendingSent[played % NET_MAX_INPUTS]) * 1000;
+    stats.latencyMs = stats.latencyMs ? stats.latencyMs * 0.9f +
+                                        sample * 0.1f : sample;
+    lastPlayed = played;
+  }
+  return true;
+}
+
+void clientUpdate(struct playerState *self) {
+  uint8_t packet[NET_PACKET];
+  ssize_t length;
+  bool updated = false;
+  while ((length = recv(sock, packet, sizeof(packet), 0)) > 0) {
+    bytesThisSecond += length;
+    if (readSnapshot(packet, length)) {
+      snapshotsThisSecond++;
+      updated = true;
+    }
+  }
+
+  // reconcile: where the server says we are, plus
+  // the inputs it has not played yet
+  if (updated) {
+    const struct snapshot *s = &received[latestTick % NET_HISTORY];
+    for (int i = 0; i < s->count; i++) {
+      if (s->entities[i].id != selfId)
+        continue;
+      *self = entityState(&s->entities[i]);
+      for (uint32_t seq = lastPlayed + 1; seq < nextInput; seq++)
+        applyInput(self, pending[seq % NET_MAX_INPUTS]);
+    }
+  }
+
+  // ack snapshots at least once a tick even when
+  // nothing is pressed
+  if (now() - lastSend >= 1.0 / NET_TICK_HZ)
+    sendInputs();
+
+  double elapsed = now() - secondStart;
+  if (elapsed >= 1) {
+    stats.bytesPerSecond = bytesThisSecond / elapsed;
+    stats.snapshotsPerSecond = snapshotsThisSecond / elapsed;
+    bytesThisSecond = snapshotsThisSecond = 0;
+    secondStart = now();
+  }
+}
+
+int clientEntities(struct netEntity *out) {
+  const struct snapshot *s = &received[latestTick % NET_HISTORY];
+  if (!latestTick || s->tick != latestTick)
+    return 0;
+  int count = 0;
+  for (int i = 0; i < s->count; i++)
+    if (s->entities[i].id != selfId)
+      out[count++] = s->entities[i];
+  return count;
+}
+
+void clientReport(struct clientStats *out) {
+  stats.id = selfId;
+  stats.pendingInputs = nextInput - lastPlayed - 1;
+  *out = stats;
+}
+
+void stopClient() {
+  if (sock >= 0)
+    close(sock);
+  sock = -1;
+}
@@ -0,0 +1,26 @@
+/* Monotonic clock.
+ *
+ * The one clock everything times itself with, in
+ * seconds for reports and pacing and in nanoseconds
+ * for the per column ray costs.
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+
+static inline double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static inline uint64_t nanoClock() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+#endif
@@ -14,47 +14,139 @@
 #include <math.h>
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "doom_text.h"
+#include "level.h"
+#include "portal.h"
+#include "pvs.h"
+#include "bsp.h"
+#include "light.h"
+#include "texture.h"
+#include "glyph.h"
+#include "aa.h"
+#include "pool.h"
+#include "broadcast.h"
+#include "player.h"
+#include "net.h"
+#include "session.h"
+#include "record.h"
+#include "share.h"
+#include "batch.h"
+#include "raylog.h"
+#include "heat.h"
+#include "arena.h"
+#include "audit.h"
+#include "resize.h"
+#include "fixed.h"
+#include "fastmath.h"
+#include "term.h"
+#include "startup.h"
+#include "clock.h"
 
 // show debug info?
 #define DEBUG true
 
-// how far the player can see
-#define MAX_DEPTH 25
+// most cameras on screen at once, the player plus
+// security cameras
+#define MAX_CAMERAS 4
 
-// colors
-#define BLACK 0
-#define WHITE 1
-
-// color pairs
-#define TEXT 0
-#define BLACK_ON_BLACK 1
-
-// num of different shades
-#define SHADES 20
-
-// starting number for wall colors
-#define WALL_SHADE_START 10
-
-#define FLOOR_SHADE_START (WALL_SHADE_START + SHADES)
-
-// characters to draw with
-#define WALL_CHAR ' '
-#define FLOOR_CHAR ' '
+// how far security cameras sweep either side, and
+// how many seconds a sweep takes
+#define CAMERA_SWEEP (M_PI / 4.0f)
+#define CAMERA_PERIOD 8.0f
 
 // players position and angle
-float playerX = 8;
-float playerY = 8;
-float playerA = 0.0f;
+struct playerState player = { 8, 8, 0.0f };
+
+// playing on a server, set by --connect
+bool multiplayer = false;
 
 // players field of view
 float playerFOV = M_PI / 4.0f;
 
+// renderer in use
+int renderer = RENDER_GRID;
+
+// textured walls, toggled with 't'
+bool texturesOn = true;
+
+// shade with glyphs instead of colour, toggled with
+// 'g' and always on when colours cannot be changed
+bool glyphMode = false;
+bool colorsOk = false;
+
+// brightest the floor gets in glyph mode
+#define GLYPH_FLOOR 96
+
+// glyph mode brightness of each wall shade, shades
+// are linear but glyph coverage is closer to how
+// bright they look
+uint8_t glyphShade[SHADES + 1];
+
+// security cameras from the map, each sweeping
+// around the angle it started at
+struct camera monitors[MAX_CAMERAS - 1];
+float monitorAngle[MAX_CAMERAS - 1];
+int numMonitors;
+
+// split the screen between the player and every
+// security camera, toggled with 'v'
+bool splitScreen = false;
+
+// every view is drawn into framebuffer (see
+// resize.h) before going to the screen in one pass.
+// depthBuffer holds the distance to the wall in each
+// column of the players view, for --share, and
+// rayBuffer what its rays did, for --raylog
+bool rayStatsOn = false;
+
+// ray cost heatmap, cycled with 'h', and whether it
+// draws rays on the minimap, toggled with 'y'
+int heatMode = HEAT_OFF;
+bool heatRays = false;
+
+// when the rendering thread last finished a column
+__thread uint64_t columnClock;
+
+// whether the last handleUserInput saw a key
+bool keyPressed = false;
+
+// what a renderer reported for one view
+struct viewStats {
+  int sectorsVisited;
+  struct bspStats bsp;
+};
+
+// a frames worth of views for the worker pool
+struct frameJob {
+  struct view *views;
+  struct viewStats *stats;
+};
+
+// anti-aliased wall edges, toggled with 'x'
+bool aaOn = false;
+bool aaOk = false;
+
+// light carried by the player, toggled with 'l'
+struct pointLight lantern = { 0, 0, 6.0f, 160 };
+bool lanternOn = false;
+
+// compiled level, from --level or built from the map below
+struct level level;
+
+// cells visible from the players cell, only rebuilt
+// when the player moves into another cell
+uint8_t *visibleCells;
+int visibleFrom = -1;
+int visibleCount;
+
 // hardcoded map
-const int mapWidth = 20;
-const int mapHeight = 20;
+int mapWidth = 20;
+int mapHeight = 20;
 const char *map = "####################"
-                  "#..................#"
-                  "#..................#"
+                  "#.................C#"
+                  "#....*.............#"
                   "#..................#"
                   "###############....#"
                   "#..................#"
@@ -69,194 +161,372 @@ const char *map = "####################"
                   "#..........#########"
                   "#..........#.......#"
                   "#..................#"
-                  "#..........#.......#"
-                  "#..........#.......#"
+                  "#..........#...*...#"
+                  "#C.........#.......#"
                   "####################";
 
-// helper method
+// helper methods
 bool handleUserInput();
-
-int main() {
-  /* ncurses settings */
-  initscr();                  // init main window
-  cbreak();                   // dont buffer input
-  noecho();                   // dont echo input
-  nonl();                     // dont echo return -> newline
-  nodelay(stdscr, TRUE);      // dont block on getch
-  intrflush(stdscr, FALSE);   // dont flush output on interupt
-  keypad(stdscr, TRUE);       // enable terminal keypad
-  curs_set(0);                // hide cursor
-
-
-  /* color definitions */
-  start_color();
-
-  // defining white on black pair for text
-  init_color(BLACK, 0, 0, 0);     // default black
-  init_color(WHITE, 0, 0, 0);     // default white
-  init_pair(TEXT, WHITE, BLACK);  // pair for white on black text
-
-  // defining the darkening shades for the walls
-  for (int i = WALL_SHADE_START; i < SHADES + WALL_SHADE_START; i++) {
-    short shade = ((short) (800.0f / SHADES)) * (i - WALL_SHADE_START);
-    init_color(i, shade, shade, shade);
-    init_pair(i, i, i);
+void updateVisibleCells();
+void findMonitors();
+int layoutViews(struct view *views, int w, int h);
+void renderView(int index, void *arg);
+void findFace(struct rayHit *hit, const struct camera *cam,
+              float unitX, float unitY);
+void drawTexturedWall(struct view *v, int col, int h,
+                      const struct rayHit *hit, short pair,
+                      int ceiling, int floor);
+void drawGlyphColumn(int col, int h, const struct rayHit *hit);
+const int8_t *wallTexels(int h, const struct rayHit *hit, float *top,
+                         float *span, int *size);
+
+int main(int argc, char **argv) {
+  startupBegin();
+
+  /* command line */
+  const char *levelPath = NULL;
+  const char *broadcastPath = NULL;
+  const char *serverAddress = NULL;
+  int serverPort = 0;
+  int bots = 0;
+  int hostPort = 0;
+  int maxFrames = 0;
+  const char *recordPath = NULL;
+  const char *shareName = NULL;
+  const char *batchPath = NULL;
+  const char *outDir = ".";
+  bool cellDumps = false;
+  const char *rayLogPath = NULL;
+  int backend = TERM_NCURSES;
+  bool startupTimes = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+      levelPath = argv[++i];
+    } else if (strcmp(argv[i], "--broadcast") == 0 && i + 1 < argc) {
+      broadcastPath = argv[++i];
+    } else if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+      serverPort = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--bots") == 0 && i + 1 < argc) {
+      bots = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+      serverAddress = argv[++i];
+    } else if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) {
+      hostPort = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      maxFrames = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      recordPath = argv[++i];
+    } else if (strcmp(argv[i], "--share") == 0 && i + 1 < argc) {
+      shareName = argv[++i];
+    } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+      batchPath = argv[++i];
+    } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      outDir = argv[++i];
+    } else if (strcmp(argv[i], "--cells") == 0) {
+      cellDumps = true;
+    } else if (strcmp(argv[i], "--raylog") == 0 && i + 1 < argc) {
+      rayLogPath = argv[++i];
+    } else if (strcmp(argv[i], "--fixed") == 0) {
+      fixedMath = true;
+    } else if (strcmp(argv[i], "--ansi") == 0) {
+      backend = TERM_ANSI;
+    } else if (strcmp(argv[i], "--startup") == 0) {
+      startupTimes = true;
+    } else {
+      fprintf(stderr, "usage: %s [--level FILE] [--broadcast SOCKET] "
+              "[--frames N] [--record FILE] [--share NAME] "
+              "[--raylog FILE] [--fixed] [--ansi] [--startup] "
+              "[--server PORT [--bots N] | --connect HOST:PORT | "
+              "--host PORT | --batch POSES [--out DIR] [--cells]]\n",
+              argv[0]);
+      return 1;
+    }
   }
-
-  // defining the darkening shades for the floor
-  for (int i = FLOOR_SHADE_START; i < SHADES + FLOOR_SHADE_START; i++) {
-    short shade = ((short) (600.0f / SHADES)) * (i - FLOOR_SHADE_START);
-    init_color(i, 0, shade, 0);
-    init_pair(i, i, i);
+  // from here on this is the game, even when recording
+  if (recordPath && startRecording(recordPath) < 0)
+    return 1;
+  if (broadcastPath && startBroadcast(broadcastPath) < 0)
+    return 1;
+  if (shareName && startShare(shareName) < 0)
+    return 1;
+  if (rayLogPath && startRayLog(rayLogPath) < 0)
+    return 1;
+  if (serverAddress && startClient(serverAddress) < 0)
+    return 1;
+  multiplayer = serverAddress != NULL;
+  startupPhase("outputs");
+
+  /* level setup */
+  if (levelPath) {
+    if (openLevel(&level, levelPath) < 0) {
+      fprintf(stderr, "%s: not a compiled level\n", levelPath);
+      return 1;
+    }
+  } else {
+    size_t size;
+    void *data = compileLevel(map, mapWidth, mapHeight, COMPILE_LIGHTS,
+                              &size, NULL);
+    if (!data || useLevel(&level, data, size) < 0) {
+      fprintf(stderr, "could not compile the built in map\n");
+      return 1;
+    }
   }
+  map = level.grid;
+  mapWidth = level.header->width;
+  mapHeight = level.header->height;
+  startupPhase("level");
+
+  // a server needs the map and the trig tables
+  // players move with, nothing else
+  initFixed();
+  if (serverPort)
+    return runServer(serverPort, bots);
+
+  buildSectors();
+  buildShadeLUT();
+  buildTextures();
+  buildGlyphTable();
+  for (int i = 0; i <= SHADES; i++)
+    glyphShade[i] = 255 * sqrtf((float) i / SHADES);
+  startupPhase("tables");
+
+  // hosted sessions and batches render on their own,
+  // without ncurses, but with the same colors
+  definePalette();
+  if (hostPort)
+    return runHost(hostPort);
+  if (batchPath)
+    return runBatch(batchPath, outDir, cellDumps);
+
+  visibleCells = malloc(pvsRowBytes(mapWidth, mapHeight));
+  findMonitors();
+  startPool();
+  prepareScreen();            // warmed up while the terminal starts
+  startupPhase("pool");
+
+  /* terminal settings */
+  if (startTerm(backend) < 0)
+    return 1;
+  initResize();               // size buffers on SIGWINCH
+  startupPhase("terminal");
 
-  // define useful black on black color pair
-  init_pair(BLACK_ON_BLACK, BLACK, BLACK);
 
-  // check that we can actually use color
-  if (!can_change_color()) {
-    printf("This terminal does not support color");
-    endwin();
-    return 1;
-  }
+  /* color definitions */
+
+  // without colour fall back to shading with glyphs.
+  // definitions only reach the terminal once a frame
+  // shows them
+  colorsOk = termColors() > 0;
+  glyphMode = !colorsOk;
+
+  aaOk = colorsOk && initEdgePairs();
+  initHeatPairs();
+  if (broadcastPath)
+    broadcastPalette();
+  sharePalette();
+  startupPhase("palette");
+  waitPool();
+  startupPhase("warm up");
 
   /* game loop */
-  struct timespec start, end;
+  struct timespec start, end, launch;
   int fps = 0;
+  int frames = 0;
+  clock_gettime(CLOCK_MONOTONIC, &launch);
+  initArena(&frameArena, FRAME_ARENA_SIZE);
+  // startup runs to the end of the first frame, and
+  // only that frame's phases are marked
+  bool firstFrame = true;
   while (1) {
     // getting fps
     clock_gettime(CLOCK_REALTIME, &start);
+    resetArena(&frameArena);
 
-    // current height and width of the terminal screen
-    int h, w;
-    getmaxyx(stdscr, h, w);
+    // current height and width of the terminal
+    // screen, which only changes on SIGWINCH
+    bool resized = resizeScreen();
+    int w = screenW, h = screenH;
+    if (firstFrame)
+      startupPhase("layout");
 
     /* user input */
     if (handleUserInput()) {
       // user quit the program
       break;
     }
+    if (multiplayer)
+      clientUpdate(&player);
+    auditFrame(keyPressed || resized);
+
+    updateVisibleCells();
+    lantern.x = player.x;
+    lantern.y = player.y;
+    updateLightGrid(&lantern, lanternOn ? 1 : 0);
+
+    // security cameras sweep back and forth
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    float seconds = (now.tv_sec - launch.tv_sec) +
+                    (now.tv_nsec - launch.tv_nsec) / 1e9f;
+    for (int i = 0; i < numMonitors; i++)
+      monitors[i].a = monitorAngle[i] + CAMERA_SWEEP *
+                      sinf(seconds * 2 * M_PI / CAMERA_PERIOD);
 
     /* Raycasting */
-    erase();
-    for (int col = 0; col < w; col++) {
-      // get the current angle of the ray to cast
-      float rayAngle = (playerA - playerFOV / 2) +
-        ((float)col / w) * playerFOV;
-
-      float unitX = cos(rayAngle);
-      float unitY = sin(rayAngle);
-
-      // calculate distance to a wall
-      float distanceToWall = 0;
-      bool hit = false;
-
-      while (!hit && distanceToWall < MAX_DEPTH) {
-        distanceToWall += 0.1f;
-
-        int testX = (int) (playerX + unitX * distanceToWall);
-        int testY = (int) (playerY + unitY * distanceToWall);
-        if (testX < 0 || testX >= mapWidth ||
-            testY < 0 || testY > mapHeight) {
-          // the ray extends past the map boundaries
-          hit = true;
-          distanceToWall = MAX_DEPTH;
-        } else if (map[testY * mapWidth + testX] == '#') {
-          // the ray has just hit a block
-          hit = true;
-        }
-      }
-
-      // caclulate how high to draw the wall
-      int ceiling = (h / 2.0) - (h / distanceToWall);
-      if (ceiling < 0) ceiling = 0;
-      int floor = h - ceiling;
-
-      // determine which color pair to draw wall with
-      short pair = BLACK_ON_BLACK;
-      for (int i = WALL_SHADE_START + SHADES - 1; i >= WALL_SHADE_START; i--) {
-        if (distanceToWall < ((float)MAX_DEPTH / (i - WALL_SHADE_START))) {
-          pair = i;
-          break;
-        }
-      }
-
-      // draw the wall
-      attron(COLOR_PAIR(pair));
-      move(ceiling, col);
-      vline(WALL_CHAR, floor - ceiling);
-      attroff(COLOR_PAIR(pair));
-
-      // draw the floor one character at a time
-      attron(TEXT);
-      for (int i = floor; i < h; i++) {
-        float b = (i - h / 2.0f) / (h / 2.0f);
-        pair = (b * (SHADES - 1)) + FLOOR_SHADE_START;
-        attron(COLOR_PAIR(pair));
-        move(i, col);
-        addch(FLOOR_CHAR);
-        attroff(COLOR_PAIR(pair));
-      }
+    for (int i = 0; i < w * h; i++)
+      framebuffer[i] = ' ' | COLOR_PAIR(TEXT);
+    for (int i = 0; i < w; i++) {
+      struct rayStat none = { MAX_DEPTH, -1, -1, 0, 0, 0, 0 };
+      depthBuffer[i] = MAX_DEPTH;
+      rayBuffer[i] = none;
     }
 
-    // print map and character
-    attron(COLOR_PAIR(TEXT));
-    for (int row = 0; row < mapHeight; row++) {
-      move(row, w - mapWidth);
-      printw("%.*s", mapWidth, map + (row * mapWidth));
+    struct view views[MAX_CAMERAS];
+    struct viewStats stats[MAX_CAMERAS];
+    struct frameJob job = { views, stats };
+    rayStatsOn = rayLogPath || heatMode != HEAT_OFF;
+    int numViews = layoutViews(views, w, h);
+    runPool(renderView, numViews, &job);
+    if (firstFrame)
+      startupPhase("render");
+
+    broadcastFrame(framebuffer, w, h);
+    shareFrame(framebuffer, w, h, depthBuffer, views[0].w);
+    logRays(&views[0].cam, renderer, rayBuffer, views[0].w);
+    int sectorsVisited = stats[0].sectorsVisited;
+    struct bspStats bspStats = stats[0].bsp;
+
+    // print map and character, over the frame the
+    // spectators got
+    for (int row = 0; row < mapHeight; row++)
+      drawText(row, w - mapWidth, TEXT, "%.*s", mapWidth,
+               map + (row * mapWidth));
+
+    long heat = 0;
+    if (heatMode != HEAT_OFF)
+      heat = drawHeat(&views[0], rayBuffer, heatMode, heatRays,
+                      w - mapWidth);
+
+    drawChar((int) player.y, (int) player.x + w - mapWidth,
+             '@' | COLOR_PAIR(TEXT));
+
+    // other players by the last digit of their id
+    struct netEntity others[MAX_ENTITIES];
+    int numOthers = multiplayer ? clientEntities(others) : 0;
+    for (int i = 0; i < numOthers; i++) {
+      struct playerState other = entityState(&others[i]);
+      drawChar((int) other.y, (int) other.x + w - mapWidth,
+               ('0' + others[i].id % 10) | COLOR_PAIR(TEXT));
     }
 
-    move((int) playerY, (int) playerX + w - mapWidth);
-    addch('@');
+    // name every security camera's view
+    for (int i = 1; i < numViews; i++)
+      drawText(views[i].y, views[i].x, TEXT, "CAM %d", i);
 
     if (DEBUG) {
       // print debug info
-      move(h - 1, 0);
-      clrtoeol();
-      printw("Angle: %.3f X: %f Y: %f FOV: %f Fps: %d Cols: %d, Rows: %d",
-             playerA, playerX, playerY, playerFOV, fps, h, w);
-      attroff(COLOR_PAIR(TEXT));
+      clearRow(h - 1);
+      int col = drawText(h - 1, 0, TEXT, "Angle: %.3f X: %f Y: %f FOV: %f "
+                         "Fps: %d Cols: %d, Rows: %d", player.a, player.x,
+                         player.y, playerFOV, fps, h, w);
+      col = drawText(h - 1, col, TEXT, " PVS: %d/%d", visibleCount,
+                     mapWidth * mapHeight);
+      if (renderer == RENDER_PORTAL)
+        col = drawText(h - 1, col, TEXT, " Sectors: %d/%d", sectorsVisited,
+                       sectorCount());
+      if (renderer == RENDER_BSP)
+        col = drawText(h - 1, col, TEXT, " Nodes: %d/%d Segs: %d/%d",
+                       bspStats.nodes, level.numNodes, bspStats.segs,
+                       level.numSegs);
+      if (broadcastPath) {
+        struct broadcastStats spectating;
+        char backlog[128];
+        broadcastReport(&spectating, backlog, sizeof(backlog));
+        col = drawText(h - 1, col, TEXT,
+                       " Spectators: %d Diff: %zuB Resyncs: %d %s",
+                       spectating.spectators, spectating.diffBytes,
+                       spectating.resyncs, backlog);
+      }
+      if (multiplayer) {
+        struct clientStats net;
+        clientReport(&net);
+        col = drawText(h - 1, col, TEXT, " Net: id %d RTT %.0fms %dB/s "
+                       "%d snapshots/s pending %d", net.id, net.latencyMs,
+                       net.bytesPerSecond, net.snapshotsPerSecond,
+                       net.pendingInputs);
+      }
+      if (heatMode != HEAT_OFF)
+        col = drawText(h - 1, col, TEXT, " Heat: %ld%s per column at most",
+                       heat, heatMode == HEAT_TIME ? "ns" : " steps");
+      if (fixedMath)
+        col = drawText(h - 1, col, TEXT, " Fixed");
+      if (resizeCount > 1)
+        col = drawText(h - 1, col, TEXT, " Resized: %d times, last in %.2fms",
+                       resizeCount - 1, resizeSeconds * 1000);
+      if (syncOutput)
+        col = drawText(h - 1, col, TEXT, " Sync");
+      if (coalescedFrames)
+        col = drawText(h - 1, col, TEXT, " Coalesced: %d", coalescedFrames);
+      if (startupSeconds())
+        col = drawText(h - 1, col, TEXT, " First frame: %.2fms",
+                       startupSeconds() * 1000);
     }
 
-    refresh();
+    presentFrame(framebuffer, w, h);
+    if (firstFrame) {
+      startupDone();
+      firstFrame = false;
+    }
 
     clock_gettime(CLOCK_REALTIME, &end);
     fps = 1000000000.0f / (end.tv_nsec - start.tv_nsec);
+
+    // benchmarks run a fixed number of frames
+    if (maxFrames && ++frames == maxFrames)
+      break;
   }
 
   // cleanup
-  endwin();
+  stopTerm();
+  auditReport();
+  if (startupTimes)
+    startupReport();
+  stopPool();
+  stopBroadcast();
+  stopShare();
+  stopRayLog();
+  stopClient();
+  freeResize();
+  free(visibleCells);
+  freeArena(&frameArena);
+  closeLevel(&level);
   return 0;
 }
 
 // updates globals based on user input, returns
 // whether the user hit the quit button
 bool handleUserInput() {
-  int ch = getch();
-  float newX = playerX;
-  float newY = playerY;
+  int ch = termKey();
+  keyPressed = ch != ERR;
+  int input = INPUT_NONE;
   switch (ch) {
     case 'w':
-      newX = playerX + cos(playerA);
-      newY = playerY + sin(playerA);
+      input = INPUT_FORWARD;
       break;
     case 'a':
-      newX = playerX + sin(playerA);
-      newY = playerY - cos(playerA);
+      input = INPUT_LEFT;
       break;
     case 's':
-      newX = playerX - cos(playerA);
-      newY = playerY - sin(playerA);
+      input = INPUT_BACK;
       break;
     case 'd':
-      newX = playerX - sin(playerA);
-      newY = playerY + cos(playerA);
+      input = INPUT_RIGHT;
       break;
     case KEY_LEFT:
-      playerA -= M_PI / 32.0;
+      input = INPUT_TURN_LEFT;
       break;
     case KEY_RIGHT:
-      playerA += M_PI / 32.0;
+      input = INPUT_TURN_RIGHT;
       break;
     case '+':
       playerFOV += M_PI / 32.0;
@@ -264,15 +534,380 @@ bool handleUserInput() {
     case '-':
       playerFOV -= M_PI / 32.0;
       break;
+    case 't':
+      texturesOn = !texturesOn;
+      break;
+    case 'f':
+      fixedMath = !fixedMath;
+      break;
+    case 'g':
+      glyphMode = !glyphMode || !colorsOk;
+      break;
+    case 'x':
+      aaOn = !aaOn && aaOk;
+      break;
+    case 'v':
+      splitScreen = !splitScreen;
+      break;
+    case 'l':
+      lanternOn = !lanternOn;
+      break;
+    case 'r':
+      renderer = (renderer + 1) % RENDERERS;
+      break;
+    case 'h':
+      heatMode = (heatMode + 1) % HEAT_MODES;
+      break;
+    case 'y':
+      heatRays = !heatRays;
+      break;
     case 'q':
       return true;
   }
 
-  /* collision detection */
-  if (map[(int) newY * mapWidth + (int) newX] != '#') {
-    playerX = newX;
-    playerY = newY;
-  }
+  // predict moves straight away, unless the server
+  // is too far behind to take another
+  if (input != INPUT_NONE && (!multiplayer || clientInput(input)))
+    applyInput(&player, input);
 
   return false;
 }
+
+void definePalette() {
+  // defining white on black pair for text
+  setColor(BLACK, 0, 0, 0);       // default black
+  setColor(WHITE, 0, 0, 0);       // default white
+  setPair(TEXT, WHITE, BLACK);    // pair for white on black text
+
+  // defining the darkening shades for the walls
+  for (int i = WALL_SHADE_START; i < SHADES + WALL_SHADE_START; i++) {
+    short shade = ((short) (800.0f / SHADES)) * (i - WALL_SHADE_START);
+    setColor(i, shade, shade, shade);
+    setPair(i, i, i);
+  }
+
+  // defining the darkening shades for the floor
+  for (int i = FLOOR_SHADE_START; i < SHADES + FLOOR_SHADE_START; i++) {
+    short shade = ((short) (600.0f / SHADES)) * (i - FLOOR_SHADE_START);
+    setColor(i, 0, shade, 0);
+    setPair(i, i, i);
+  }
+
+  // define useful black on black color pair
+  setPair(BLACK_ON_BLACK, BLACK, BLACK);
+}
+
+// refreshes the visible set once the player
+// has moved into a different cell
+void updateVisibleCells() {
+  int cell = (int) player.y * mapWidth + (int) player.x;
+  if (cell == visibleFrom)
+    return;
+
+  decompressPVS(&level, cell, visibleCells);
+  visibleFrom = cell;
+  visibleCount = 0;
+  for (int i = 0; i < mapWidth * mapHeight; i++)
+    visibleCount += pvsTest(visibleCells, i);
+}
+
+// security cameras are CAMERA_CHAR cells in the map,
+// each starts out looking at the middle of the map
+void findMonitors() {
+  numMonitors = 0;
+  for (int i = 0; i < mapWidth * mapHeight; i++) {
+    if (map[i] != CAMERA_CHAR || numMonitors == MAX_CAMERAS - 1)
+      continue;
+    struct camera *cam = &monitors[numMonitors];
+    cam->x = i % mapWidth + 0.5f;
+    cam->y = i / mapWidth + 0.5f;
+    cam->fov = M_PI / 3.0f;
+    monitorAngle[numMonitors++] = atan2f(mapHeight / 2.0f - cam->y,
+                                         mapWidth / 2.0f - cam->x);
+  }
+}
+
+// splits the w x h screen between the cameras in a
+// grid two views wide, returns how many views
+int layoutViews(struct view *views, int w, int h) {
+  int count = splitScreen ? 1 + numMonitors : 1;
+  int cols = count > 1 ? 2 : 1;
+  int rows = (count + cols - 1) / cols;
+  for (int i = 0; i < count; i++) {
+    struct view *v = &views[i];
+    int col = i % cols;
+    int row = i / cols;
+    v->x = col * w / cols;
+    v->y = row * h / rows;
+    v->w = (col + 1) * w / cols - v->x;
+    v->h = (row + 1) * h / rows - v->y;
+    v->cells = framebuffer;
+    v->stride = w;
+    v->depth = i == 0 ? depthBuffer : NULL;
+    v->rays = i == 0 && rayStatsOn ? rayBuffer : NULL;
+    if (i == 0) {
+      struct camera eye = { player.x, player.y, player.a, playerFOV };
+      v->cam = eye;
+    } else {
+      v->cam = monitors[i - 1];
+    }
+  }
+  return count;
+}
+
+// renders one view of a frameJob, runs on the pool
+void renderView(int index, void *arg) {
+  struct frameJob *job = arg;
+  struct view *v = &job->views[index];
+  struct viewStats *stats = &job->stats[index];
+
+  int renderW = v->w, renderH = v->h;
+  if (glyphMode) {
+    // renderers draw samples rather than cells
+    resizeGlyphs(v->w, v->h);
+    renderW = v->w * GLYPH_SUB;
+    renderH = v->h * GLYPH_SUB;
+  } else if (aaOn) {
+    // renderers cast subrays rather than columns
+    resizeAA();
+    renderW = v->w * AA_SUB;
+  }
+
+  stats->sectorsVisited = 0;
+  memset(&stats->bsp, 0, sizeof(stats->bsp));
+  if (v->rays)
+    columnClock = nanoClock();
+  if (renderer == RENDER_PORTAL) {
+    stats->sectorsVisited = renderPortals(v, renderW, renderH);
+  } else if (renderer == RENDER_BSP) {
+    renderBSP(v, &level, renderW, renderH, &stats->bsp);
+  } else if (fixedMath) {
+    renderGridFixed(v, renderW, renderH);
+  } else {
+    renderGrid(v, renderW, renderH);
+  }
+
+  if (glyphMode)
+    presentGlyphs(v, v->w, v->h);
+  else if (aaOn)
+    resolveAA(v, v->w, v->h);
+}
+
+// works out which face of the wall cell the ray went
+// in through, and where across that face
+void findFace(struct rayHit *hit, const struct camera *cam,
+              float unitX, float unitY) {
+  float tx = -INFINITY;
+  float ty = -INFINITY;
+  if (unitX > 0) tx = (hit->cellX - cam->x) / unitX;
+  if (unitX < 0) tx = (hit->cellX + 1 - cam->x) / unitX;
+  if (unitY > 0) ty = (hit->cellY - cam->y) / unitY;
+  if (unitY < 0) ty = (hit->cellY + 1 - cam->y) / unitY;
+
+  if (tx > ty) {
+    hit->face = unitX > 0 ? FACE_WEST : FACE_EAST;
+    hit->u = faceU(hit->face, cam->y + tx * unitY);
+  } else {
+    hit->face = unitY > 0 ? FACE_NORTH : FACE_SOUTH;
+    hit->u = faceU(hit->face, cam->x + ty * unitX);
+  }
+}
+
+// casts one ray per column by marching through the
+// map grid until something solid is hit
+void renderGrid(struct view *v, int w, int h) {
+  const struct camera *cam = &v->cam;
+  for (int col = 0; col < w; col++) {
+    // get the current angle of the ray to cast
+    float rayAngle = (cam->a - cam->fov / 2) +
+      ((float)col / w) * cam->fov;
+
+    float unitX, unitY;
+    fastSinCos(rayAngle, &unitY, &unitX);
+
+    // calculate distance to a wall
+    float distanceToWall = 0;
+    bool hit = false;
+    struct rayHit wall = { 0, -1, -1, 0, 0, 0 };
+
+    while (!hit && distanceToWall < MAX_DEPTH) {
+      distanceToWall += 0.1f;
+      wall.steps++;
+
+      int testX = (int) (cam->x + unitX * distanceToWall);
+      int testY = (int) (cam->y + unitY * distanceToWall);
+      if (testX < 0 || testX >= mapWidth ||
+          testY < 0 || testY >= mapHeight) {
+        // the ray extends past the map boundaries
+        hit = true;
+        distanceToWall = MAX_DEPTH;
+      } else if (map[testY * mapWidth + testX] == '#') {
+        // the ray has just hit a block
+        hit = true;
+        wall.cellX = testX;
+        wall.cellY = testY;
+      }
+    }
+
+    wall.distance = distanceToWall;
+    if (wall.cellX >= 0)
+      findFace(&wall, cam, unitX, unitY);
+    drawColumn(v, col, h, &wall);
+  }
+}
+
+// determine which color pair to draw wall with
+short shadeForDistance(float distanceToWall) {
+  for (int i = WALL_SHADE_START + SHADES - 1; i >= WALL_SHADE_START; i--) {
+    if (distanceToWall < ((float)MAX_DEPTH / (i - WALL_SHADE_START))) {
+      return i;
+    }
+  }
+  return BLACK_ON_BLACK;
+}
+
+// picks the strip of texture a wall column is drawn
+// from, and where the whole wall sits on screen
+const int8_t *wallTexels(int h, const struct rayHit *hit, float *top,
+                         float *span, int *size) {
+  *span = 2 * h / hit->distance;
+  *top = h / 2.0f - *span / 2;
+  int mip = mipForHeight(*span);
+  *size = TEX_SIZE >> mip;
+  return textureColumn(textureFor(hit->cellX, hit->cellY), mip, hit->u);
+}
+
+int texelShade(short pair, const int8_t *texels, int size, int v) {
+  if (v < 0) v = 0;
+  if (v > size - 1) v = size - 1;
+  int shade = pair - WALL_SHADE_START + texels[v];
+  if (shade < 0) shade = 0;
+  if (shade > SHADES - 1) shade = SHADES - 1;
+  return shade;
+}
+
+// draws the wall part of a column from one strip of
+// its texture, rows sharing a shade go out as one line
+void drawTexturedWall(struct view *v, int col, int h,
+                      const struct rayHit *hit, short pair,
+                      int ceiling, int floor) {
+  float top, span;
+  int size;
+  const int8_t *texels = wallTexels(h, hit, &top, &span, &size);
+
+  int runStart = ceiling;
+  short runPair = -1;
+  for (int row = ceiling; row <= floor; row++) {
+    short rowPair = -1;
+    if (row < floor)
+      rowPair = WALL_SHADE_START +
+                texelShade(pair, texels, size,
+                           (row + 0.5f - top) / span * size);
+
+    if (rowPair != runPair) {
+      if (runPair != -1)
+        fillColumn(v, col, runStart, row - runStart, WALL_CHAR, runPair);
+      runStart = row;
+      runPair = rowPair;
+    }
+  }
+}
+
+int wallCeiling(int h, float distanceToWall) {
+  int ceiling = (h / 2.0) - (h / distanceToWall);
+  return ceiling < 0 ? 0 : ceiling;
+}
+
+short floorShade(int row, int h) {
+  float b = (row - h / 2.0f) / (h / 2.0f);
+  if (b < 0) b = 0;
+  return (b * (SHADES - 1)) + FLOOR_SHADE_START;
+}
+
+void drawColumn(struct view *v, int col, int h, const struct rayHit *hit) {
+  // the nearest of the rays that make up the cell
+  int cell = glyphMode ? col / GLYPH_SUB : aaOn ? col / AA_SUB : col;
+  if (v->depth && hit->distance < v->depth[cell])
+    v->depth[cell] = hit->distance;
+  if (v->rays) {
+    struct rayStat *stat = &v->rays[cell];
+    if (hit->distance < stat->distance || stat->cellX < 0) {
+      stat->distance = hit->distance;
+      stat->cellX = hit->cellX;
+      stat->cellY = hit->cellY;
+      stat->face = hit->face;
+    }
+    int steps = stat->steps + hit->steps;
+    stat->steps = steps < UINT16_MAX ? steps : UINT16_MAX;
+    uint64_t now = nanoClock();
+    stat->nanos += now - columnClock;
+    columnClock = now;
+  }
+  if (glyphMode)
+    drawGlyphColumn(col, h, hit);
+  else if (aaOn)
+    recordSubray(col, hit);
+  else
+    drawCells(v, col, h, hit);
+}
+
+void drawCells(struct view *v, int col, int h, const struct rayHit *hit) {
+  if (fixedMath) {
+    drawFixedCells(v, col, h, hit);
+    return;
+  }
+
+  // caclulate how high to draw the wall
+  int ceiling = wallCeiling(h, hit->distance);
+  int floor = h - ceiling;
+
+  short pair = shadeForHit(hit);
+
+  // draw the wall
+  if (texturesOn && hit->cellX >= 0 && pair != BLACK_ON_BLACK) {
+    drawTexturedWall(v, col, h, hit, pair, ceiling, floor);
+  } else {
+    fillColumn(v, col, ceiling, floor - ceiling, WALL_CHAR, pair);
+  }
+
+  // draw the floor one character at a time
+  for (int i = floor; i < h; i++)
+    putCell(v, i, col, FLOOR_CHAR, floorShade(i, h));
+}
+
+// glyph mode version of drawColumn, col and h are in
+// samples and each row becomes one brightness
+void drawGlyphColumn(int col, int h, const struct rayHit *hit) {
+  int ceiling = wallCeiling(h, hit->distance);
+  int floor = h - ceiling;
+  short pair = shadeForHit(hit);
+
+  // rows above the wall were cleared with the buffer
+  uint8_t *sample = glyphColumn(col) + ceiling * glyphStride;
+  bool lit = hit->cellX >= 0 && pair != BLACK_ON_BLACK;
+
+  if (texturesOn && lit) {
+    // step down the texture strip one row at a time
+    float top, span;
+    int size;
+    const int8_t *texels = wallTexels(h, hit, &top, &span, &size);
+    float v = (ceiling + 0.5f - top) / span * size;
+    float step = size / span;
+    for (int row = ceiling; row < floor; row++) {
+      *sample = glyphShade[texelShade(pair, texels, size, v) + 1];
+      sample += glyphStride;
+      v += step;
+    }
+  } else {
+    uint8_t value = lit ? glyphShade[pair - WALL_SHADE_START + 1] : 0;
+    for (int row = ceiling; row < floor; row++) {
+      *sample = value;
+      sample += glyphStride;
+    }
+  }
+
+  for (int row = floor; row < h; row++) {
+    *sample = (2 * row - h) * GLYPH_FLOOR / h;
+    sample += glyphStride;
+  }
+}
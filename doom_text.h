@@ -0,0 +1,155 @@
+/* Shared definitions for the doom_text renderer.
+ * Everything the separate renderer modules need
+ * from the main game loop lives here.
+ */
+
+#ifndef DOOM_TEXT_H
+#define DOOM_TEXT_H
+
+#include <ncurses.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "level.h"
+
+// how far the player can see
+#define MAX_DEPTH 25
+
+// colors
+#define BLACK 0
+#define WHITE 1
+
+// color pairs
+#define TEXT 0
+#define BLACK_ON_BLACK 1
+
+// num of different shades
+#define SHADES 20
+
+// starting number for wall colors
+#define WALL_SHADE_START 10
+
+#define FLOOR_SHADE_START (WALL_SHADE_START + SHADES)
+
+// defines the colors and pairs above in the tables
+// of term.h, which needs no terminal, so a batch or
+// a hosted session can read them back
+void definePalette();
+
+// characters to draw with
+#define WALL_CHAR ' '
+#define FLOOR_CHAR ' '
+
+// map character that marks a security camera
+#define CAMERA_CHAR 'C'
+
+// available renderers, cycled with 'r'
+#define RENDER_GRID 0
+#define RENDER_PORTAL 1
+#define RENDER_BSP 2
+#define RENDERERS 3
+
+// map data
+extern int mapWidth;
+extern int mapHeight;
+extern const char *map;
+
+// compiled level the map came from
+extern struct level level;
+
+// cells visible from the players cell (see pvs.h)
+extern uint8_t *visibleCells;
+
+// whether walls are textured, toggled with 't'
+extern bool texturesOn;
+
+// a point of view the world can be rendered from
+struct camera {
+  float x, y;
+  float a;
+  float fov;
+};
+
+// one camera drawn into the x, y, w, h rectangle of
+// a framebuffer of cells stride wide. views may be
+// rendered on worker threads at the same time, so
+// renderers keep their per frame scratch thread
+// local and only write to their own rectangle.
+// depth, when set, gets the distance to the nearest
+// wall in each of the views w columns, and rays
+// what the rays of each column did
+struct view {
+  struct camera cam;
+  int x, y, w, h;
+  chtype *cells;
+  int stride;
+  float *depth;
+  struct rayStat *rays;
+};
+
+// sets one cell of a view
+static inline void putCell(struct view *v, int row, int col,
+                           chtype ch, short pair) {
+  v->cells[(v->y + row) * v->stride + v->x + col] = ch | COLOR_PAIR(pair);
+}
+
+// sets count cells of a view downwards from row
+static inline void fillColumn(struct view *v, int col, int row, int count,
+                              chtype ch, short pair) {
+  chtype *cell = v->cells + (v->y + row) * v->stride + v->x + col;
+  for (int i = 0; i < count; i++, cell += v->stride)
+    *cell = ch | COLOR_PAIR(pair);
+}
+
+// where a ray ended up, cellX/cellY is the wall cell,
+// face is the FACE_* side of it that was hit and u
+// runs from 0 to 1 across that face. steps is the
+// work it took: grid steps marched, sectors crossed
+// or BSP segs tried, depending on the renderer
+struct rayHit {
+  float distance;
+  int cellX, cellY;
+  int face;
+  float u;
+  int steps;
+};
+
+// one column of a view as --raylog keeps it. the
+// hit is the nearest of the columns rays and steps
+// the sum of them
+struct rayStat {
+  float distance;
+  int16_t cellX, cellY;   // -1 when nothing was hit
+  uint8_t face;
+  uint8_t unused;
+  uint16_t steps;
+  uint32_t nanos;         // time from the columns before
+};
+
+// casts one ray per column straight through the grid
+void renderGrid(struct view *v, int w, int h);
+
+// picks the wall color pair for a given distance
+short shadeForDistance(float distanceToWall);
+
+// top row of a wall distance away, the wall ends
+// the same number of rows from the bottom
+int wallCeiling(int h, float distanceToWall);
+
+// floor color pair for a row below the horizon
+short floorShade(int row, int h);
+
+// the shade (0 to SHADES - 1) of texel v of a wall
+// lit as pair
+int texelShade(short pair, const int8_t *texels, int size, int v);
+
+// draws one column (wall and floor) of a view for a
+// ray that hit a wall hit->distance units away, h is
+// the height the view is being rendered at
+void drawColumn(struct view *v, int col, int h, const struct rayHit *hit);
+
+// drawColumn straight to the views cells, whatever
+// mode the renderer is in
+void drawCells(struct view *v, int col, int h, const struct rayHit *hit);
+
+#endif
@@ -0,0 +1,210 @@
+/* fastcheck - accuracy of fastmath.h against libm.
+ *
+ * Usage: fastcheck
+ *
+ * Sweeps the scalar and the FAST_LANES wide version
+ * of every function in fastmath.h over the inputs
+ * the header promises, compares each result with
+ * libm in double precision and prints the largest
+ * error seen and where. Exits with 1 if any error is
+ * past the bound the header documents.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "fastmath.h"
+
+// samples across [-SINCOS_RANGE, SINCOS_RANGE]
+#define SINCOS_RANGE 8192.0
+#define SINCOS_SAMPLES (1 << 22)
+
+// angles around the circle, at every radius
+#define ATAN2_ANGLES 65536
+#define ATAN2_RADII 9
+
+// steps through the bits of positive normal floats,
+// odd so every mantissa pattern gets its turn
+#define BITS_STRIDE 97
+
+struct check {
+  const char *name;
+  // documented largest error
+  double bound;
+  double worst;
+  float at;
+  float at2;
+  long samples;
+};
+
+static struct check checks[] = {
+  {.name = "fastSinCos", .bound = 9.4e-8},
+  {.name = "fastSinCosLanes", .bound = 9.4e-8},
+  {.name = "fastAtan2", .bound = 2.0e-6},
+  {.name = "fastAtan2Lanes", .bound = 2.0e-6},
+  {.name = "fastRecip", .bound = 1.6e-7},
+  {.name = "fastRecipLanes", .bound = 1.6e-7},
+  {.name = "fastRsqrt", .bound = 1.8e-3},
+  {.name = "fastRsqrtLanes", .bound = 1.8e-3},
+};
+
+enum { SINCOS, SINCOS_LANES, ATAN2, ATAN2_LANES, RECIP, RECIP_LANES,
+       RSQRT, RSQRT_LANES };
+
+static void note(struct check *c, double error, float at, float at2) {
+  // nan never compares, so catch it here
+  if (error != error)
+    error = INFINITY;
+  if (error > c->worst || c->samples == 0) {
+    c->worst = error;
+    c->at = at;
+    c->at2 = at2;
+  }
+  c->samples++;
+}
+
+static void noteSinCos(struct check *c, float x, float s, float co) {
+  double es = fabs(s - sin(x));
+  double ec = fabs(co - cos(x));
+  note(c, es > ec ? es : ec, x, 0);
+}
+
+static void noteAtan2(struct check *c, float y, float x, float a) {
+  double error = fabs(a - atan2(y, x));
+  // either side of the cut along negative x is fine
+  if (error > M_PI)
+    error = fabs(error - 2 * M_PI);
+  note(c, error, y, x);
+}
+
+static void checkSinCos(void) {
+  vfloat xs;
+  for (int i = 0; i <= SINCOS_SAMPLES; i++) {
+    float x = -SINCOS_RANGE + 2 * SINCOS_RANGE * i / SINCOS_SAMPLES;
+    // nudge off the grid so it hits no multiple of pi
+    // more often than chance
+    x = nextafterf(x, i & 1 ? INFINITY : -INFINITY);
+    if (fabsf(x) >= SINCOS_RANGE)
+      continue;
+    float s, c;
+    fastSinCos(x, &s, &c);
+    noteSinCos(&checks[SINCOS], x, s, c);
+    xs[i % FAST_LANES] = x;
+    if (i % FAST_LANES == FAST_LANES - 1) {
+      vfloat vs, vc;
+      fastSinCosLanes(xs, &vs, &vc);
+      for (int l = 0; l < FAST_LANES; l++)
+        noteSinCos(&checks[SINCOS_LANES], xs[l], vs[l], vc[l]);
+    }
+  }
+  // closer in near zero, through the bits of floats
+  // up to 4, as the grid above steps over them
+  vfloat small;
+  int n = 0;
+  for (uint32_t bits = 0x33800000; bits < 0x40800000; bits += BITS_STRIDE) {
+    float x;
+    memcpy(&x, &bits, sizeof(x));
+    for (int sign = -1; sign <= 1; sign += 2) {
+      float s, c;
+      fastSinCos(sign * x, &s, &c);
+      noteSinCos(&checks[SINCOS], sign * x, s, c);
+      small[n++] = sign * x;
+      if (n == FAST_LANES) {
+        vfloat vs, vc;
+        fastSinCosLanes(small, &vs, &vc);
+        for (int l = 0; l < FAST_LANES; l++)
+          noteSinCos(&checks[SINCOS_LANES], small[l], vs[l], vc[l]);
+        n = 0;
+      }
+    }
+  }
+}
+
+static void checkAtan2(void) {
+  static const float radii[ATAN2_RADII] = {
+    1e-30f, 1e-10f, 1e-3f, 0.5f, 1, 3, 1e3f, 1e10f, 1e30f,
+  };
+  vfloat ys, xs;
+  int n = 0;
+  for (int r = 0; r < ATAN2_RADII; r++) {
+    for (int i = 0; i < ATAN2_ANGLES; i++) {
+      double angle = -M_PI + 2 * M_PI * (i + 0.5) / ATAN2_ANGLES;
+      float y = radii[r] * sin(angle);
+      float x = radii[r] * cos(angle);
+      noteAtan2(&checks[ATAN2], y, x, fastAtan2(y, x));
+      ys[n] = y;
+      xs[n++] = x;
+      if (n == FAST_LANES) {
+        vfloat a = fastAtan2Lanes(ys, xs);
+        for (int l = 0; l < FAST_LANES; l++)
+          noteAtan2(&checks[ATAN2_LANES], ys[l], xs[l], a[l]);
+        n = 0;
+      }
+    }
+  }
+  // the axes and the origin
+  static const float axes[][2] = {
+    {0, 1}, {1, 0}, {0, -1}, {-1, 0}, {0, 0}, {1, 1}, {-1, -1},
+    {1, -1},
+  };
+  for (int i = 0; i < (int) (sizeof(axes) / sizeof(axes[0])); i++) {
+    float y = axes[i][0], x = axes[i][1];
+    noteAtan2(&checks[ATAN2], y, x, fastAtan2(y, x));
+    vfloat a = fastAtan2Lanes((vfloat) {} + y, (vfloat) {} + x);
+    noteAtan2(&checks[ATAN2_LANES], y, x, a[0]);
+  }
+}
+
+// recip and rsqrt, over positive normal floats whose
+// results are normal too
+static void checkBits(void) {
+  vfloat xs;
+  int n = 0;
+  for (uint32_t bits = 0x00800000; bits < 0x7f800000; bits += BITS_STRIDE) {
+    float x;
+    memcpy(&x, &bits, sizeof(x));
+    double recip = 1.0 / x;
+    double rsqrt = 1.0 / sqrt(x);
+    bool recipNormal = recip >= FLT_MIN && recip <= FLT_MAX;
+    if (recipNormal)
+      note(&checks[RECIP], fabs(fastRecip(x) - recip) / recip, x, 0);
+    note(&checks[RSQRT], fabs(fastRsqrt(x) - rsqrt) / rsqrt, x, 0);
+    xs[n++] = x;
+    if (n == FAST_LANES) {
+      vfloat vr = fastRecipLanes(xs);
+      vfloat vs = fastRsqrtLanes(xs);
+      for (int l = 0; l < FAST_LANES; l++) {
+        double r = 1.0 / xs[l];
+        double s = 1.0 / sqrt(xs[l]);
+        if (r >= FLT_MIN && r <= FLT_MAX)
+          note(&checks[RECIP_LANES], fabs(vr[l] - r) / r, xs[l], 0);
+        note(&checks[RSQRT_LANES], fabs(vs[l] - s) / s, xs[l], 0);
+      }
+      n = 0;
+    }
+  }
+}
+
+int main(void) {
+  checkSinCos();
+  checkAtan2();
+  checkBits();
+  bool failed = false;
+  printf("%-16s %10s %10s %10s  %s\n", "", "samples", "worst", "bound",
+         "at");
+  for (int i = 0; i < (int) (sizeof(checks) / sizeof(checks[0])); i++) {
+    struct check *c = &checks[i];
+    bool ok = c->worst <= c->bound;
+    failed |= !ok;
+    printf("%-16s %10ld %10.4g %10.3g  %.9g", c->name, c->samples, c->worst,
+           c->bound, c->at);
+    if (i == ATAN2 || i == ATAN2_LANES)
+      printf(", %.9g", c->at2);
+    printf("%s\n", ok ? "" : "  FAIL");
+  }
+  return failed;
+}
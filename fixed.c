@@ -0,0 +1,143 @@
+/* Fixed point ray caster and trig tables. */
+
+#include "fixed.h"
+#include "light.h"
+#include "texture.h"
+
+// pi in 2.30, and 1.0
+#define PI_Q30 3373259426ll
+#define ONE_Q30 (1ll << 30)
+
+bool fixedMath = false;
+
+fixed sineTable[TRIG_SIZE];
+
+// sin x for x in 0 .. pi / 2, all in 2.30, from its
+// Taylor series to x^13
+static int64_t sineQ30(int64_t x) {
+  int64_t x2 = (x * x) >> 30;
+  int64_t r = ONE_Q30;
+  for (int n = 13; n >= 3; n -= 2)
+    r = ONE_Q30 - ((x2 * r) >> 30) / (n * (n - 1));
+  return (x * r) >> 30;
+}
+
+void initFixed() {
+  // one quarter from the series, the rest mirrored
+  int quarter = TRIG_SIZE / 4;
+  for (int i = 0; i <= quarter; i++) {
+    int64_t x = i * 2 * PI_Q30 / TRIG_SIZE;
+    fixed s = (sineQ30(x) + (1 << 13)) >> 14;
+    sineTable[i] = s;
+    sineTable[2 * quarter - i] = s;
+    sineTable[(2 * quarter + i) & (TRIG_SIZE - 1)] = -s;
+    sineTable[(4 * quarter - i) & (TRIG_SIZE - 1)] = -s;
+  }
+}
+
+// findFace in fixed point
+static void findFixedFace(struct rayHit *hit, fixed camX, fixed camY,
+                          fixed unitX, fixed unitY) {
+  fixed tx = INT32_MIN;
+  fixed ty = INT32_MIN;
+  if (unitX > 0) tx = fixedDiv((hit->cellX << FIXED_SHIFT) - camX, unitX);
+  if (unitX < 0) tx = fixedDiv(((hit->cellX + 1) << FIXED_SHIFT) - camX, unitX);
+  if (unitY > 0) ty = fixedDiv((hit->cellY << FIXED_SHIFT) - camY, unitY);
+  if (unitY < 0) ty = fixedDiv(((hit->cellY + 1) << FIXED_SHIFT) - camY, unitY);
+
+  fixed along;
+  if (tx > ty) {
+    hit->face = unitX > 0 ? FACE_WEST : FACE_EAST;
+    along = camY + fixedMul(tx, unitY);
+  } else {
+    hit->face = unitY > 0 ? FACE_NORTH : FACE_SOUTH;
+    along = camX + fixedMul(ty, unitX);
+  }
+  fixed f = along & (FIXED_ONE - 1);
+  if (hit->face != FACE_WEST && hit->face != FACE_SOUTH)
+    f = FIXED_ONE - f;
+  hit->u = fromFixed(f);
+}
+
+void renderGridFixed(struct view *v, int w, int h) {
+  const struct camera *cam = &v->cam;
+  fixed camX = toFixed(cam->x);
+  fixed camY = toFixed(cam->y);
+  uint32_t fov = toAngle(cam->fov);
+  uint32_t left = toAngle(cam->a) - fov / 2;
+  for (int col = 0; col < w; col++) {
+    uint32_t rayAngle = left + (uint32_t) ((uint64_t) fov * col / w);
+    fixed unitX = fixedCos(rayAngle);
+    fixed unitY = fixedSin(rayAngle);
+
+    // the same march as renderGrid, in 0.1 steps
+    fixed distance = 0;
+    bool hit = false;
+    struct rayHit wall = { 0, -1, -1, 0, 0, 0 };
+    while (!hit && distance < MAX_DEPTH * FIXED_ONE) {
+      distance += FIXED_STEP;
+      wall.steps++;
+
+      int testX = (camX + fixedMul(unitX, distance)) >> FIXED_SHIFT;
+      int testY = (camY + fixedMul(unitY, distance)) >> FIXED_SHIFT;
+      if (testX < 0 || testX >= mapWidth ||
+          testY < 0 || testY >= mapHeight) {
+        hit = true;
+        distance = MAX_DEPTH * FIXED_ONE;
+      } else if (map[testY * mapWidth + testX] == '#') {
+        hit = true;
+        wall.cellX = testX;
+        wall.cellY = testY;
+      }
+    }
+
+    // both exact as floats, so nothing downstream
+    // rounds them differently
+    wall.distance = fromFixed(distance);
+    if (wall.cellX >= 0)
+      findFixedFace(&wall, camX, camY, unitX, unitY);
+    drawColumn(v, col, h, &wall);
+  }
+}
+
+void drawFixedCells(struct view *v, int col, int h, const struct rayHit *hit) {
+  fixed distance = toFixed(hit->distance);
+  fixed span = fixedDiv(2 * h << FIXED_SHIFT, distance);
+  fixed top = h * (FIXED_ONE / 2) - span / 2;
+  int ceiling = top > 0 ? top >> FIXED_SHIFT : 0;
+  int floor = h - ceiling;
+
+  // lighting only multiplies and divides exact
+  // values, which rounds the same everywhere
+  short pair = shadeForHit(hit);
+
+  if (texturesOn && hit->cellX >= 0 && pair != BLACK_ON_BLACK) {
+    int mip = mipForHeight(fromFixed(span));
+    int size = TEX_SIZE >> mip;
+    const int8_t *texels = textureColumn(textureFor(hit->cellX, hit->cellY),
+                                         mip, hit->u);
+    int runStart = ceiling;
+    short runPair = -1;
+    for (int row = ceiling; row <= floor; row++) {
+      short rowPair = -1;
+      if (row < floor) {
+        int64_t down = (int64_t) (row * FIXED_ONE + FIXED_ONE / 2) - top;
+        rowPair = WALL_SHADE_START +
+                  texelShade(pair, texels, size, down * size / span);
+      }
+      if (rowPair != runPair) {
+        if (runPair != -1)
+          fillColumn(v, col, runStart, row - runStart, WALL_CHAR, runPair);
+        runStart = row;
+        runPair = rowPair;
+      }
+    }
+  } else {
+    fillColumn(v, col, ceiling, floor - ceiling, WALL_CHAR, pair);
+  }
+
+  for (int row = floor; row < h; row++) {
+    int shade = row * 2 > h ? (2 * row - h) * (SHADES - 1) / h : 0;
+    putCell(v, row, col, FLOOR_CHAR, FLOOR_SHADE_START + shade);
+  }
+}
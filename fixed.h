@@ -0,0 +1,98 @@
+/* Fixed point ray casting.
+ *
+ * With --fixed (or 'f') the grid ray caster, the
+ * wall projection and player movement run in 16.16
+ * fixed point with table trig instead of float and
+ * libm, so the same pose gives the same cells and
+ * the same inputs the same moves on every host and
+ * compiler. That is what lockstep play and replays
+ * need. A server and its clients have to agree on
+ * it.
+ *
+ * Angles are binary, a whole turn is 2^32 so they
+ * wrap on their own. The sine table is built with
+ * integer arithmetic only, and lookups interpolate
+ * between its entries.
+ */
+
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "doom_text.h"
+
+typedef int32_t fixed;
+
+#define FIXED_SHIFT 16
+#define FIXED_ONE (1 << FIXED_SHIFT)
+
+// a quarter turn as a binary angle
+#define ANGLE_QUARTER 0x40000000u
+
+// entries in the sine table, a power of two
+#define TRIG_BITS 12
+#define TRIG_SIZE (1 << TRIG_BITS)
+
+// how far a fixed point ray marches each step, 0.1
+#define FIXED_STEP (FIXED_ONE / 10)
+
+// whether the fixed point path is in use
+extern bool fixedMath;
+
+extern fixed sineTable[TRIG_SIZE];
+
+// builds the sine table, once at startup
+void initFixed();
+
+static inline fixed toFixed(float f) {
+  return (fixed) lrintf(f * FIXED_ONE);
+}
+
+// exact while |f| is below 256
+static inline float fromFixed(fixed f) {
+  return f / (float) FIXED_ONE;
+}
+
+static inline fixed fixedMul(fixed a, fixed b) {
+  return (fixed) (((int64_t) a * b) >> FIXED_SHIFT);
+}
+
+// saturates rather than wrapping when b is tiny
+static inline fixed fixedDiv(fixed a, fixed b) {
+  int64_t q = ((int64_t) a << FIXED_SHIFT) / b;
+  if (q > INT32_MAX) return INT32_MAX;
+  if (q < INT32_MIN) return INT32_MIN;
+  return (fixed) q;
+}
+
+static inline uint32_t toAngle(float radians) {
+  return (uint32_t) llrint(radians * (4294967296.0 / (2 * M_PI)));
+}
+
+static inline float fromAngle(uint32_t angle) {
+  return (float) (angle * (2 * M_PI / 4294967296.0));
+}
+
+static inline fixed fixedSin(uint32_t angle) {
+  uint32_t index = angle >> (32 - TRIG_BITS);
+  int64_t along = (angle >> (32 - TRIG_BITS - 16)) & 0xffff;
+  fixed s0 = sineTable[index];
+  fixed s1 = sineTable[(index + 1) & (TRIG_SIZE - 1)];
+  return s0 + (fixed) (((s1 - s0) * along) >> 16);
+}
+
+static inline fixed fixedCos(uint32_t angle) {
+  return fixedSin(angle + ANGLE_QUARTER);
+}
+
+// renderGrid in fixed point
+void renderGridFixed(struct view *v, int w, int h);
+
+// drawCells in fixed point, hit has to come from
+// renderGridFixed for the frame to be exact
+void drawFixedCells(struct view *v, int col, int h, const struct rayHit *hit);
+
+#endif
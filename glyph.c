@@ -0,0 +1,115 @@
+/* Sample reduction and glyph lookup for the
+ * monochrome renderer. Cells are reduced eight
+ * at a time (one register of 16 bit lanes) with
+ * gcc vector extensions, only the final table
+ * lookup is done a lane at a time.
+ */
+
+#include <string.h>
+
+#include "glyph.h"
+#include "resize.h"
+
+// cells reduced together
+#define LANES 8
+
+// glyphs from empty to full coverage
+#define RAMP " .:-=+*#%@"
+#define RAMP_LEVELS ((int) sizeof(RAMP) - 1)
+
+// edge directions, none first
+#define EDGE_NONE 0
+#define EDGE_VERTICAL 1
+#define EDGE_FLOOR 2
+#define EDGE_CEILING 3
+#define EDGE_RISING 4
+#define EDGE_FALLING 5
+#define EDGES 6
+
+// an edge needs the halves of a cell to differ by
+// at least 1 / EDGE_CONTRAST of the cells total, and
+// the cell to be at least EDGE_MINIMUM in total
+#define EDGE_CONTRAST 2
+#define EDGE_MINIMUM 128
+
+typedef uint8_t v8u8 __attribute__((vector_size(LANES)));
+typedef int16_t v8i16 __attribute__((vector_size(LANES * 2)));
+
+__thread uint8_t *glyphSamples;
+__thread int glyphStride;
+__thread int glyphSampleRows;
+
+static char glyphTable[RAMP_LEVELS * EDGES];
+
+void buildGlyphTable() {
+  static const char edgeChar[EDGES] = { 0, '|', '_', '-', '/', '\\' };
+  for (int level = 0; level < RAMP_LEVELS; level++) {
+    for (int edge = 0; edge < EDGES; edge++) {
+      glyphTable[level * EDGES + edge] =
+        edge == EDGE_NONE ? RAMP[level] : edgeChar[edge];
+    }
+  }
+}
+
+void resizeGlyphs(int w, int h) {
+  glyphStride = (w + LANES - 1) / LANES * LANES;
+  glyphSampleRows = h * GLYPH_SUB;
+  glyphSamples = threadScratch()->samples;
+  memset(glyphSamples, 0, GLYPH_SUB * glyphSampleRows * glyphStride);
+}
+
+// the samples of one row of a plane, widened
+static v8i16 loadRow(int plane, int row, int cell) {
+  v8u8 bytes;
+  memcpy(&bytes, glyphSamples + (plane * glyphSampleRows + row) *
+                 glyphStride + cell, sizeof(bytes));
+  return __builtin_convertvector(bytes, v8i16);
+}
+
+// reduces the cells [cell, cell + LANES) of one
+// screen row into indices into the glyph table
+static v8i16 reduce(int row, int cell) {
+  v8i16 left = { 0 }, right = { 0 }, top = { 0 }, bottom = { 0 };
+  for (int plane = 0; plane < GLYPH_SUB; plane++) {
+    for (int y = 0; y < GLYPH_SUB; y++) {
+      v8i16 s = loadRow(plane, row * GLYPH_SUB + y, cell);
+      if (plane < GLYPH_SUB / 2) left += s; else right += s;
+      if (y < GLYPH_SUB / 2) top += s; else bottom += s;
+    }
+  }
+
+  // at most 16 * 255 per lane, so nothing overflows
+  // (the mean is total >> 4, GLYPH_SUB being 4)
+  v8i16 total = left + right;
+  v8i16 level = ((total >> 4) * RAMP_LEVELS) >> 8;
+  v8i16 gx = right - left;
+  v8i16 gy = bottom - top;
+  v8i16 ax = (gx ^ (gx >> 15)) - (gx >> 15);
+  v8i16 ay = (gy ^ (gy >> 15)) - (gy >> 15);
+
+  // comparisons give 0 or -1 per lane
+  v8i16 edge = ((ax + ay) * EDGE_CONTRAST >= total) &
+               (total >= EDGE_MINIMUM);
+  v8i16 vertical = ax > ay * 2;
+  v8i16 horizontal = ay > ax * 2;
+  v8i16 diagonal = ~(vertical | horizontal);
+  v8i16 litBelow = gy > 0;
+  v8i16 rising = (gx ^ gy) >= 0;
+
+  v8i16 kind = (vertical & EDGE_VERTICAL) |
+                (horizontal & litBelow & EDGE_FLOOR) |
+                (horizontal & ~litBelow & EDGE_CEILING) |
+                (diagonal & rising & EDGE_RISING) |
+                (diagonal & ~rising & EDGE_FALLING);
+  return level * EDGES + (kind & edge);
+}
+
+void presentGlyphs(struct view *v, int w, int h) {
+  for (int row = 0; row < h; row++) {
+    for (int cell = 0; cell < w; cell += LANES) {
+      v8i16 index = reduce(row, cell);
+      for (int i = 0; i < LANES && cell + i < w; i++)
+        putCell(v, row, cell + i, glyphTable[index[i]], TEXT);
+    }
+  }
+}
@@ -0,0 +1,46 @@
+/* Glyph shading, for terminals without colour.
+ *
+ * Renderers draw into a sample buffer GLYPH_SUB
+ * times finer than the screen both ways, one
+ * brightness (0 - 255) per sample. Each cells
+ * block of samples is reduced to how much of it
+ * is lit and which way any edge through it runs,
+ * and those pick a glyph from a precomputed table.
+ */
+
+#ifndef GLYPH_H
+#define GLYPH_H
+
+#include <stdint.h>
+
+#include "doom_text.h"
+
+// samples per cell along each axis
+#define GLYPH_SUB 4
+
+// samples are stored in GLYPH_SUB planes, one per
+// sample column within a cell, so that the same
+// sample of neighbouring cells sits side by side.
+// each rendering thread has its own buffer
+extern __thread uint8_t *glyphSamples;
+extern __thread int glyphStride;
+extern __thread int glyphSampleRows;
+
+// builds the glyph table, once at startup
+void buildGlyphTable();
+
+// clears this threads sample buffer for w x h cells
+void resizeGlyphs(int w, int h);
+
+// the top sample of sample column x, the samples
+// below it are glyphStride apart
+static inline uint8_t *glyphColumn(int x) {
+  return glyphSamples + (x % GLYPH_SUB) * glyphSampleRows * glyphStride +
+         x / GLYPH_SUB;
+}
+
+// reduces the samples to glyphs and draws them
+// into a view w x h cells big
+void presentGlyphs(struct view *v, int w, int h);
+
+#endif
@@ -0,0 +1,128 @@
+/* Ray cost heatmap drawing. */
+
+#include <limits.h>
+#include <math.h>
+
+#include "heat.h"
+#include "arena.h"
+#include "fastmath.h"
+#include "term.h"
+
+// how far apart a ray is sampled when walking it
+// across the minimap
+#define WALK_STEP 0.25f
+
+// blue through green and yellow to red, 0 - 1000
+static const short heatColors[HEAT_SHADES][3] = {
+  { 0, 0, 400 }, { 0, 300, 700 }, { 0, 600, 400 }, { 300, 800, 0 },
+  { 700, 800, 0 }, { 900, 600, 0 }, { 1000, 300, 0 }, { 1000, 0, 0 }
+};
+
+// characters for when there are no colors to spare
+static const char heatChars[HEAT_SHADES + 1] = " .:-=+#@";
+
+static bool heatColorsOk;
+
+bool initHeatPairs() {
+  heatColorsOk = termColors() >= HEAT_COLOR_START + HEAT_SHADES &&
+                 termPairs() >= HEAT_PAIR_START + HEAT_SHADES;
+  if (!heatColorsOk)
+    return false;
+  for (int i = 0; i < HEAT_SHADES; i++) {
+    setColor(HEAT_COLOR_START + i, heatColors[i][0], heatColors[i][1],
+             heatColors[i][2]);
+    setPair(HEAT_PAIR_START + i, BLACK, HEAT_COLOR_START + i);
+  }
+  return true;
+}
+
+static long costOf(const struct rayStat *ray, int mode) {
+  return mode == HEAT_TIME ? ray->nanos : ray->steps;
+}
+
+// spread over the range seen so small differences
+// still show
+static int shadeOf(float cost, float coolest, float hottest) {
+  if (hottest <= coolest)
+    return HEAT_SHADES - 1;
+  int shade = (cost - coolest) / (hottest - coolest) * (HEAT_SHADES - 1) +
+              0.5f;
+  return shade < 0 ? 0 : shade < HEAT_SHADES ? shade : HEAT_SHADES - 1;
+}
+
+// draws a cell as heat, keeping its character when
+// there are colors to show the heat with
+static void heatCell(int row, int col, chtype ch, int shade) {
+  if (heatColorsOk)
+    drawChar(row, col, ch | COLOR_PAIR(HEAT_PAIR_START + shade));
+  else if (ch == HEAT_RAY_CHAR)
+    drawChar(row, col, ch | COLOR_PAIR(TEXT));
+  else
+    drawChar(row, col, heatChars[shade] | COLOR_PAIR(TEXT));
+}
+
+long drawHeat(const struct view *v, const struct rayStat *rays, int mode,
+              bool showRays, int mapLeft) {
+  long hottest = 0, coolest = LONG_MAX;
+  for (int col = 0; col < v->w; col++) {
+    long cost = costOf(&rays[col], mode);
+    if (cost > hottest) hottest = cost;
+    if (cost < coolest) coolest = cost;
+  }
+
+  // the strip sits above the debug line
+  int stripRow = v->y + v->h - 2 > v->y ? v->y + v->h - 2 : v->y;
+  for (int col = 0; col < v->w; col++)
+    heatCell(stripRow, v->x + col, ' ',
+             shadeOf(costOf(&rays[col], mode), coolest, hottest));
+
+  // every cell a ray crosses gets that rays cost
+  // once, and is marked if it is a drawn ray
+  int cellHeatSize = mapWidth * mapHeight;
+  float *cellHeat = arenaAlloc(&frameArena, cellHeatSize * sizeof(float));
+  bool *cellRay = arenaAlloc(&frameArena, cellHeatSize * sizeof(bool));
+  for (int i = 0; i < cellHeatSize; i++) {
+    cellHeat[i] = 0;
+    cellRay[i] = false;
+  }
+  const struct camera *cam = &v->cam;
+  for (int col = 0; col < v->w; col++) {
+    float angle = cam->a - cam->fov / 2 + (col + 0.5f) / v->w * cam->fov;
+    float unitX, unitY;
+    fastSinCos(angle, &unitY, &unitX);
+    bool drawn = showRays && col % HEAT_RAY_EVERY == HEAT_RAY_EVERY / 2;
+    int last = -1;
+    for (float t = 0; t <= rays[col].distance; t += WALK_STEP) {
+      int x = cam->x + unitX * t;
+      int y = cam->y + unitY * t;
+      if (x < 0 || x >= mapWidth || y < 0 || y >= mapHeight)
+        break;
+      int cell = y * mapWidth + x;
+      if (cell == last)
+        continue;
+      last = cell;
+      // a cost of 0 still marks the cell as crossed
+      cellHeat[cell] += costOf(&rays[col], mode) + 1e-3f;
+      cellRay[cell] |= drawn && map[cell] == '.';
+    }
+  }
+
+  float hottestCell = 0, coolestCell = INFINITY;
+  for (int i = 0; i < cellHeatSize; i++) {
+    if (cellHeat[i] > hottestCell)
+      hottestCell = cellHeat[i];
+    if (cellHeat[i] > 0 && cellHeat[i] < coolestCell)
+      coolestCell = cellHeat[i];
+  }
+  for (int row = 0; row < mapHeight; row++) {
+    for (int col = 0; col < mapWidth; col++) {
+      int cell = row * mapWidth + col;
+      if (cellHeat[cell] == 0)
+        continue;
+      chtype ch = cellRay[cell] ? HEAT_RAY_CHAR : map[cell];
+      heatCell(row, mapLeft + col, ch,
+               shadeOf(cellHeat[cell], coolestCell, hottestCell));
+    }
+  }
+  return hottest;
+}
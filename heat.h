@@ -0,0 +1,51 @@
+/* Ray cost heatmap.
+ *
+ * A debug view, cycled with 'h', that shows where
+ * the rays of the player's view spend their work:
+ * a strip along the bottom of the view coloured by
+ * what each column cost, and the minimap coloured
+ * by the cost of every ray that crossed each cell.
+ * Cost is grid steps (or sectors or segs, see
+ * struct rayHit) or nanoseconds between columns.
+ * 'y' also draws every HEAT_RAY_EVERYth ray on the
+ * minimap.
+ */
+
+#ifndef HEAT_H
+#define HEAT_H
+
+#include <stdbool.h>
+
+#include "doom_text.h"
+#include "aa.h"
+
+#define HEAT_OFF 0
+#define HEAT_STEPS 1
+#define HEAT_TIME 2
+#define HEAT_MODES 3
+
+// colors from cold to hot
+#define HEAT_SHADES 8
+
+// heat colors go after the shades, and their pairs
+// after the edge pairs
+#define HEAT_COLOR_START (FLOOR_SHADE_START + SHADES)
+#define HEAT_PAIR_START (EDGE_PAIR_START + AA_BACKGROUNDS * SHADES)
+
+// columns between rays drawn on the minimap
+#define HEAT_RAY_EVERY 8
+
+// map character a drawn ray leaves in a cell
+#define HEAT_RAY_CHAR ':'
+
+// defines the heat colors, false if the terminal
+// cannot, then heat is drawn with characters
+bool initHeatPairs();
+
+// draws the heat of view v from its rays, with the
+// minimap at column mapLeft, and returns the cost
+// of its most expensive column
+long drawHeat(const struct view *v, const struct rayStat *rays, int mode,
+              bool showRays, int mapLeft);
+
+#endif
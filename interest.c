@@ -0,0 +1,113 @@
+/* Per client visibility and update priority. */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "interest.h"
+#include "pvs.h"
+#include "fastmath.h"
+
+// priority a visible entity gains per tick at the
+// edge of INTEREST_RANGE, more the closer it is
+#define PRIORITY_BASE 1.0f
+
+// extra priority for entities in front of the client
+#define PRIORITY_AHEAD 2.0f
+
+bool startInterest(struct interest *in) {
+  for (int i = 0; i < MAX_ENTITIES; i++)
+    in->priority[i] = 0;
+  in->pvsCell = -1;
+  in->pvs = malloc(pvsRowBytes(mapWidth, mapHeight));
+  return in->pvs != NULL;
+}
+
+void stopInterest(struct interest *in) {
+  free(in->pvs);
+  in->pvs = NULL;
+}
+
+static const struct netEntity *findEntity(const struct snapshot *s, int id) {
+  for (int i = 0; s && i < s->count; i++)
+    if (s->entities[i].id == id)
+      return &s->entities[i];
+  return NULL;
+}
+
+void buildInterest(struct interest *in, int self,
+                   const struct snapshot *world,
+                   const struct snapshot *previous, struct snapshot *out,
+                   struct interestStats *stats) {
+  const struct netEntity *me = findEntity(world, self);
+  struct playerState eye = entityState(me);
+  int cell = (int) eye.y * mapWidth + (int) eye.x;
+  if (cell != in->pvsCell) {
+    decompressPVS(&level, cell, in->pvs);
+    in->pvsCell = cell;
+  }
+  float aheadX, aheadY;
+  fastSinCos(eye.a, &aheadY, &aheadX);
+
+  // cheapest tests first, most entities should fail
+  // on range or the PVS before a ray is walked
+  bool visible[MAX_ENTITIES] = { false };
+  stats->candidates = world->count - 1;
+  stats->visible = 0;
+  for (int i = 0; i < world->count; i++) {
+    const struct netEntity *e = &world->entities[i];
+    if (e->id == self)
+      continue;
+    struct playerState other = entityState(e);
+    float dx = other.x - eye.x;
+    float dy = other.y - eye.y;
+    float dist2 = dx * dx + dy * dy;
+    if (dist2 >= INTEREST_RANGE * INTEREST_RANGE ||
+        !pvsTest(in->pvs, (int) other.y * mapWidth + (int) other.x) ||
+        !lineOfSight(map, mapWidth, mapHeight, eye.x, eye.y, other.x,
+                     other.y)) {
+      in->priority[e->id] = 0;
+      continue;
+    }
+    visible[e->id] = true;
+    stats->visible++;
+    float dist = dist2 * fastRsqrt(dist2);
+    float gain = PRIORITY_BASE * INTEREST_RANGE * fastRecip(dist + 1);
+    if (dx * aheadX + dy * aheadY > 0)
+      gain *= PRIORITY_AHEAD;
+    in->priority[e->id] += gain;
+  }
+
+  // the budget goes to the highest priorities, which
+  // start again from nothing once sent
+  bool sending[MAX_ENTITIES] = { false };
+  sending[self] = true;
+  stats->sent = 0;
+  while (stats->sent < INTEREST_BUDGET) {
+    int best = -1;
+    for (int id = 0; id < MAX_ENTITIES; id++)
+      if (visible[id] && !sending[id] &&
+          (best < 0 || in->priority[id] > in->priority[best]))
+        best = id;
+    if (best < 0)
+      break;
+    sending[best] = true;
+    in->priority[best] = 0;
+    stats->sent++;
+  }
+
+  // world is sorted by id so out is too. visible
+  // entities left out of the budget keep the state
+  // the client already has, or wait to be sent
+  out->tick = world->tick;
+  out->count = 0;
+  for (int i = 0; i < world->count; i++) {
+    const struct netEntity *e = &world->entities[i];
+    if (sending[e->id]) {
+      out->entities[out->count++] = *e;
+    } else if (visible[e->id]) {
+      const struct netEntity *old = findEntity(previous, e->id);
+      if (old)
+        out->entities[out->count++] = *old;
+    }
+  }
+}
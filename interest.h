@@ -0,0 +1,55 @@
+/* Interest management for the server.
+ *
+ * Each tick every client gets its own snapshot
+ * holding only the entities it could see: within
+ * INTEREST_RANGE, in the PVS of its cell, and with
+ * a clear line through the grid. Of those, at most
+ * INTEREST_BUDGET are updated per snapshot. Every
+ * visible entity builds up priority each tick it
+ * waits, faster when it is close or in front, and
+ * the highest are sent. The rest stay in the
+ * snapshot as the client last saw them, which the
+ * delta encoder sends for free.
+ */
+
+#ifndef INTEREST_H
+#define INTEREST_H
+
+#include "doom_text.h"
+#include "net.h"
+
+// how far a client hears about other entities, the
+// same as the renderer draws
+#define INTEREST_RANGE MAX_DEPTH
+
+// entity updates per snapshot, besides the client
+#define INTEREST_BUDGET 8
+
+// what one client is interested in
+struct interest {
+  float priority[MAX_ENTITIES];
+  int pvsCell;            // cell pvs was filled for
+  uint8_t *pvs;
+};
+
+// what building one clients snapshot cost
+struct interestStats {
+  int candidates;         // other entities in the world
+  int visible;
+  int sent;
+};
+
+// allocates the PVS row, returns false if it failed
+bool startInterest(struct interest *in);
+
+void stopInterest(struct interest *in);
+
+// writes the snapshot entity self should get into out,
+// from everything in world and previous, the last
+// snapshot built for self (NULL for none)
+void buildInterest(struct interest *in, int self,
+                   const struct snapshot *world,
+                   const struct snapshot *previous, struct snapshot *out,
+                   struct interestStats *stats);
+
+#endif
@@ -0,0 +1,501 @@
+/* Level loading and compiling.
+ *
+ * The compiler turns a grid map into wall segs
+ * (runs of wall faces that border floor) and
+ * builds a BSP tree over them. Partitions are
+ * always taken from seg lines, and a set of segs
+ * becomes a leaf once it is convex, i.e. every
+ * seg lies in front of every other one, so the
+ * segs of a leaf can be drawn in any order.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "level.h"
+#include "pvs.h"
+#include "light.h"
+#include "fastmath.h"
+
+// longest map row we accept
+#define MAX_ROW 4096
+
+// seg used while building, x0 <= x1 and y0 <= y1
+struct buildSeg {
+  int x0, y0, x1, y1;
+  int face;
+};
+
+// growable arrays filled in by the builder
+struct builder {
+  struct bspNode *nodes;
+  int numNodes, capNodes;
+  struct bspLeaf *leaves;
+  int numLeaves, capLeaves;
+  struct bspSeg *segs;
+  int numSegs, capSegs;
+};
+
+static void *grow(void *array, int *cap, int count, size_t item) {
+  if (count < *cap)
+    return array;
+  *cap = *cap ? *cap * 2 : 64;
+  return realloc(array, *cap * item);
+}
+
+char *readMapFile(const char *path, int *width, int *height) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    perror(path);
+    return NULL;
+  }
+
+  char line[MAX_ROW + 2];
+  char *grid = NULL;
+  int w = 0;
+  int h = 0;
+  while (fgets(line, sizeof(line), file)) {
+    int len = strcspn(line, "\r\n");
+    if (len == 0)
+      continue;
+    if (w == 0)
+      w = len;
+    if (len != w) {
+      fprintf(stderr, "%s:%d: row is %d wide, expected %d\n",
+              path, h + 1, len, w);
+      free(grid);
+      fclose(file);
+      return NULL;
+    }
+    grid = realloc(grid, (h + 1) * w);
+    memcpy(grid + h * w, line, w);
+    h++;
+  }
+  fclose(file);
+
+  if (h == 0) {
+    fprintf(stderr, "%s: empty map\n", path);
+    return NULL;
+  }
+  *width = w;
+  *height = h;
+  return grid;
+}
+
+static int isSolid(const char *grid, int width, int height, int x, int y) {
+  if (x < 0 || x >= width || y < 0 || y >= height)
+    return 1;
+  return grid[y * width + x] == '#';
+}
+
+int lineOfSight(const char *grid, int width, int height, float fromX,
+                float fromY, float toX, float toY) {
+  float dx = toX - fromX;
+  float dy = toY - fromY;
+  float length2 = dx * dx + dy * dy;
+  if (length2 == 0)
+    return 1;
+  float inverse = fastRsqrt(length2);
+  float length = length2 * inverse;
+  float unitX = dx * inverse;
+  float unitY = dy * inverse;
+
+  int mapX = (int) fromX;
+  int mapY = (int) fromY;
+  int endX = (int) toX;
+  int endY = (int) toY;
+  float deltaX = unitX == 0 ? INFINITY : fabsf(1 / unitX);
+  float deltaY = unitY == 0 ? INFINITY : fabsf(1 / unitY);
+  int stepX = unitX < 0 ? -1 : 1;
+  int stepY = unitY < 0 ? -1 : 1;
+  float sideX = (unitX < 0 ? fromX - mapX : mapX + 1 - fromX) * deltaX;
+  float sideY = (unitY < 0 ? fromY - mapY : mapY + 1 - fromY) * deltaY;
+
+  while (mapX != endX || mapY != endY) {
+    if (sideX < sideY) {
+      if (sideX > length)
+        break;
+      sideX += deltaX;
+      mapX += stepX;
+    } else {
+      if (sideY > length)
+        break;
+      sideY += deltaY;
+      mapY += stepY;
+    }
+    if (isSolid(grid, width, height, mapX, mapY))
+      return 0;
+  }
+  return 1;
+}
+
+// appends a unit wall face, extending the previous
+// seg when it continues the same run
+static void addFace(struct buildSeg **segs, int *count, int *cap,
+                    int x0, int y0, int x1, int y1, int face) {
+  if (*count > 0) {
+    struct buildSeg *last = &(*segs)[*count - 1];
+    if (last->face == face && last->x1 == x0 && last->y1 == y0 &&
+        (x0 == x1) == (last->x0 == last->x1)) {
+      last->x1 = x1;
+      last->y1 = y1;
+      return;
+    }
+  }
+  *segs = grow(*segs, cap, *count, sizeof(struct buildSeg));
+  (*segs)[*count] = (struct buildSeg) { x0, y0, x1, y1, face };
+  (*count)++;
+}
+
+// finds every face between floor and wall
+static struct buildSeg *extractSegs(const char *grid, int width,
+                                    int height, int *count) {
+  struct buildSeg *segs = NULL;
+  int cap = 0;
+  *count = 0;
+
+  // vertical faces, walked down each grid line
+  for (int x = 0; x < width; x++) {
+    for (int y = 0; y < height; y++)
+      if (!isSolid(grid, width, height, x, y) &&
+          isSolid(grid, width, height, x - 1, y))
+        addFace(&segs, count, &cap, x, y, x, y + 1, FACE_EAST);
+    for (int y = 0; y < height; y++)
+      if (!isSolid(grid, width, height, x, y) &&
+          isSolid(grid, width, height, x + 1, y))
+        addFace(&segs, count, &cap, x + 1, y, x + 1, y + 1, FACE_WEST);
+  }
+
+  // horizontal faces, walked along each grid line
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++)
+      if (!isSolid(grid, width, height, x, y) &&
+          isSolid(grid, width, height, x, y - 1))
+        addFace(&segs, count, &cap, x, y, x + 1, y, FACE_SOUTH);
+    for (int x = 0; x < width; x++)
+      if (!isSolid(grid, width, height, x, y) &&
+          isSolid(grid, width, height, x, y + 1))
+        addFace(&segs, count, &cap, x, y + 1, x + 1, y + 1, FACE_NORTH);
+  }
+  return segs;
+}
+
+// is all of b on the side a is facing (or on a's line)
+static int inFront(const struct buildSeg *a, const struct buildSeg *b) {
+  switch (a->face) {
+    case FACE_EAST:  return b->x0 >= a->x0;
+    case FACE_WEST:  return b->x1 <= a->x0;
+    case FACE_SOUTH: return b->y0 >= a->y0;
+    default:         return b->y1 <= a->y0;
+  }
+}
+
+static int isConvex(const struct buildSeg *segs, int count) {
+  for (int i = 0; i < count; i++)
+    for (int j = 0; j < count; j++)
+      if (i != j && !inFront(&segs[i], &segs[j]))
+        return 0;
+  return 1;
+}
+
+static int segAxis(const struct buildSeg *s) {
+  return s->face == FACE_EAST || s->face == FACE_WEST ? 0 : 1;
+}
+
+// which side of a partition a seg goes to, 0 or 1,
+// or -1 when it has to be split
+static int classify(const struct buildSeg *s, int axis, int value) {
+  int lo = axis == 0 ? s->x0 : s->y0;
+  int hi = axis == 0 ? s->x1 : s->y1;
+  if (lo == value && hi == value) {
+    // on the partition, goes with the side it faces
+    return s->face == FACE_EAST || s->face == FACE_SOUTH;
+  }
+  if (hi <= value)
+    return 0;
+  if (lo >= value)
+    return 1;
+  return -1;
+}
+
+static void boundSegs(const struct buildSeg *segs, int count, int16_t *bbox) {
+  int minX = segs[0].x0, minY = segs[0].y0;
+  int maxX = segs[0].x1, maxY = segs[0].y1;
+  for (int i = 1; i < count; i++) {
+    if (segs[i].x0 < minX) minX = segs[i].x0;
+    if (segs[i].y0 < minY) minY = segs[i].y0;
+    if (segs[i].x1 > maxX) maxX = segs[i].x1;
+    if (segs[i].y1 > maxY) maxY = segs[i].y1;
+  }
+  bbox[0] = minX;
+  bbox[1] = minY;
+  bbox[2] = maxX;
+  bbox[3] = maxY;
+}
+
+// builds the subtree for segs, returns the node
+// index or ~leaf index. takes ownership of segs
+static int32_t buildNode(struct builder *b, struct buildSeg *segs, int count) {
+  if (isConvex(segs, count)) {
+    b->leaves = grow(b->leaves, &b->capLeaves, b->numLeaves,
+                     sizeof(struct bspLeaf));
+    b->leaves[b->numLeaves].firstSeg = b->numSegs;
+    b->leaves[b->numLeaves].numSegs = count;
+    for (int i = 0; i < count; i++) {
+      b->segs = grow(b->segs, &b->capSegs, b->numSegs, sizeof(struct bspSeg));
+      b->segs[b->numSegs++] = (struct bspSeg) {
+        segs[i].x0, segs[i].y0, segs[i].x1, segs[i].y1, segs[i].face, 0
+      };
+    }
+    free(segs);
+    return ~b->numLeaves++;
+  }
+
+  // pick the seg line that splits least and balances best
+  int bestAxis = 0, bestValue = 0;
+  long bestCost = -1;
+  for (int i = 0; i < count; i++) {
+    int axis = segAxis(&segs[i]);
+    int value = axis == 0 ? segs[i].x0 : segs[i].y0;
+    int sides[2] = { 0, 0 };
+    int splits = 0;
+    for (int j = 0; j < count; j++) {
+      int side = classify(&segs[j], axis, value);
+      if (side == -1) {
+        splits++;
+        sides[0]++;
+        sides[1]++;
+      } else {
+        sides[side]++;
+      }
+    }
+    if (sides[0] == 0 || sides[1] == 0)
+      continue;
+    long cost = splits * 4L + labs((long) sides[0] - sides[1]);
+    if (bestCost < 0 || cost < bestCost) {
+      bestCost = cost;
+      bestAxis = axis;
+      bestValue = value;
+    }
+  }
+
+  // a non convex set always has a dividing seg line
+  struct buildSeg *side[2];
+  int sideCount[2] = { 0, 0 };
+  side[0] = malloc(2 * count * sizeof(struct buildSeg));
+  side[1] = malloc(2 * count * sizeof(struct buildSeg));
+  for (int i = 0; i < count; i++) {
+    int s = classify(&segs[i], bestAxis, bestValue);
+    if (s != -1) {
+      side[s][sideCount[s]++] = segs[i];
+      continue;
+    }
+    struct buildSeg lo = segs[i];
+    struct buildSeg hi = segs[i];
+    if (bestAxis == 0) {
+      lo.x1 = bestValue;
+      hi.x0 = bestValue;
+    } else {
+      lo.y1 = bestValue;
+      hi.y0 = bestValue;
+    }
+    side[0][sideCount[0]++] = lo;
+    side[1][sideCount[1]++] = hi;
+  }
+  free(segs);
+
+  b->nodes = grow(b->nodes, &b->capNodes, b->numNodes, sizeof(struct bspNode));
+  int index = b->numNodes++;
+  struct bspNode *node = &b->nodes[index];
+  node->axis = bestAxis;
+  node->pad = 0;
+  node->value = bestValue;
+  boundSegs(side[0], sideCount[0], node->bbox[0]);
+  boundSegs(side[1], sideCount[1], node->bbox[1]);
+
+  // children may realloc the node array
+  int32_t child0 = buildNode(b, side[0], sideCount[0]);
+  int32_t child1 = buildNode(b, side[1], sideCount[1]);
+  b->nodes[index].child[0] = child0;
+  b->nodes[index].child[1] = child1;
+  return index;
+}
+
+static size_t alignUp(size_t n) {
+  return (n + LUMP_ALIGN - 1) & ~(size_t) (LUMP_ALIGN - 1);
+}
+
+void *compileLevel(const char *grid, int width, int height, int flags,
+                   size_t *size, struct pvsStats *pvsStats) {
+  int count;
+  struct buildSeg *segs = extractSegs(grid, width, height, &count);
+  if (count == 0) {
+    free(segs);
+    return NULL;
+  }
+
+  struct builder b;
+  memset(&b, 0, sizeof(b));
+  buildNode(&b, segs, count);
+
+  const void *lumpData[LUMPS] = { 0 };
+  size_t lumpLength[LUMPS] = { 0 };
+  lumpData[LUMP_GRID] = grid;
+  lumpLength[LUMP_GRID] = (size_t) width * height;
+  lumpData[LUMP_NODES] = b.nodes;
+  lumpLength[LUMP_NODES] = b.numNodes * sizeof(struct bspNode);
+  lumpData[LUMP_LEAVES] = b.leaves;
+  lumpLength[LUMP_LEAVES] = b.numLeaves * sizeof(struct bspLeaf);
+  lumpData[LUMP_SEGS] = b.segs;
+  lumpLength[LUMP_SEGS] = b.numSegs * sizeof(struct bspSeg);
+  void *pvs = NULL;
+  if (flags & COMPILE_PVS) {
+    pvs = buildPVS(grid, width, height, &lumpLength[LUMP_PVS], pvsStats);
+    lumpData[LUMP_PVS] = pvs;
+  }
+  void *lightmap = NULL;
+  if (flags & COMPILE_LIGHTS) {
+    lightmap = bakeLightmaps(grid, width, height, &lumpLength[LUMP_LIGHTMAP]);
+    lumpData[LUMP_LIGHTMAP] = lightmap;
+  }
+
+  struct levelHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = LEVEL_MAGIC;
+  header.version = LEVEL_VERSION;
+  header.width = width;
+  header.height = height;
+
+  size_t offset = alignUp(sizeof(header));
+  for (int i = 0; i < LUMPS; i++) {
+    header.lumps[i].offset = lumpLength[i] ? offset : 0;
+    header.lumps[i].length = lumpLength[i];
+    offset = alignUp(offset + lumpLength[i]);
+  }
+
+  char *data = calloc(1, offset);
+  memcpy(data, &header, sizeof(header));
+  for (int i = 0; i < LUMPS; i++)
+    if (lumpLength[i])
+      memcpy(data + header.lumps[i].offset, lumpData[i], lumpLength[i]);
+
+  free(b.nodes);
+  free(b.leaves);
+  free(b.segs);
+  free(pvs);
+  free(lightmap);
+  *size = offset;
+  return data;
+}
+
+// checks a file image and points the level into it
+static int bindLevel(struct level *level) {
+  const struct levelHeader *header = level->data;
+  if (level->size < sizeof(*header) || header->magic != LEVEL_MAGIC ||
+      header->version != LEVEL_VERSION)
+    return -1;
+
+  for (int i = 0; i < LUMPS; i++) {
+    const struct lump *l = &header->lumps[i];
+    if ((size_t) l->offset + l->length > level->size)
+      return -1;
+  }
+  if (header->lumps[LUMP_GRID].length !=
+      (uint32_t) header->width * header->height)
+    return -1;
+
+  const char *base = level->data;
+  level->header = header;
+  level->grid = base + header->lumps[LUMP_GRID].offset;
+  level->nodes = (const void *) (base + header->lumps[LUMP_NODES].offset);
+  level->leaves = (const void *) (base + header->lumps[LUMP_LEAVES].offset);
+  level->segs = (const void *) (base + header->lumps[LUMP_SEGS].offset);
+  if (header->lumps[LUMP_PVS].length) {
+    level->pvs = (const uint8_t *) base + header->lumps[LUMP_PVS].offset;
+    level->pvsSize = header->lumps[LUMP_PVS].length;
+    if (level->pvsSize < (size_t) header->width * header->height *
+                         sizeof(uint32_t))
+      return -1;
+  }
+  if (header->lumps[LUMP_LIGHTMAP].length) {
+    if (header->lumps[LUMP_LIGHTMAP].length !=
+        (uint32_t) header->width * header->height * 4 * LIGHTMAP_RES)
+      return -1;
+    level->lightmap = (const uint8_t *) base +
+                      header->lumps[LUMP_LIGHTMAP].offset;
+  }
+  level->numNodes = header->lumps[LUMP_NODES].length / sizeof(struct bspNode);
+  level->numLeaves = header->lumps[LUMP_LEAVES].length / sizeof(struct bspLeaf);
+  level->numSegs = header->lumps[LUMP_SEGS].length / sizeof(struct bspSeg);
+
+  // the walk trusts every index, children come after
+  // their node so a bad file cannot send it round in
+  // circles either
+  if (level->numNodes == 0 && level->numLeaves == 0)
+    return -1;
+  for (int i = 0; i < level->numNodes; i++) {
+    for (int side = 0; side < 2; side++) {
+      int32_t child = level->nodes[i].child[side];
+      if (child >= 0 ? child <= i || child >= level->numNodes
+                     : ~child >= level->numLeaves)
+        return -1;
+    }
+  }
+  for (int i = 0; i < level->numLeaves; i++) {
+    const struct bspLeaf *leaf = &level->leaves[i];
+    if ((uint64_t) leaf->firstSeg + leaf->numSegs > (uint64_t) level->numSegs)
+      return -1;
+  }
+  return 0;
+}
+
+int openLevel(struct level *level, const char *path) {
+  memset(level, 0, sizeof(*level));
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size == 0) {
+    close(fd);
+    return -1;
+  }
+
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return -1;
+
+  level->data = data;
+  level->size = st.st_size;
+  level->mapped = 1;
+  if (bindLevel(level) < 0) {
+    closeLevel(level);
+    return -1;
+  }
+  return 0;
+}
+
+int useLevel(struct level *level, void *data, size_t size) {
+  memset(level, 0, sizeof(*level));
+  level->data = data;
+  level->size = size;
+  if (bindLevel(level) < 0) {
+    closeLevel(level);
+    return -1;
+  }
+  return 0;
+}
+
+void closeLevel(struct level *level) {
+  if (level->mapped)
+    munmap(level->data, level->size);
+  else
+    free(level->data);
+  memset(level, 0, sizeof(*level));
+}
@@ -0,0 +1,137 @@
+/* Compiled level format.
+ *
+ * A compiled level is one flat file made of a
+ * header followed by lumps. Every lump is an
+ * array of fixed size records in the compiling
+ * machine's byte order, so the whole file can be
+ * mmap'd and used in place without any parsing or
+ * pointer fixups, on a machine of the same order.
+ */
+
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LEVEL_MAGIC 0x4c565444   // "DTVL"
+#define LEVEL_VERSION 1
+
+// lump slots, the header always has room for all of them
+#define LUMP_GRID 0     // width * height map characters
+#define LUMP_NODES 1    // struct bspNode, root is node 0
+#define LUMP_LEAVES 2   // struct bspLeaf
+#define LUMP_SEGS 3     // struct bspSeg
+#define LUMP_PVS 4      // see pvs.h
+#define LUMP_LIGHTMAP 5 // see light.h
+#define LUMPS 8
+
+// lumps start on this boundary
+#define LUMP_ALIGN 8
+
+// which way a wall face looks, towards -x, +x, -y or +y
+#define FACE_WEST 0
+#define FACE_EAST 1
+#define FACE_NORTH 2
+#define FACE_SOUTH 3
+
+// position across a face, 0 to 1 from left to right
+// as seen from in front of it, given the x (north and
+// south faces) or y (east and west faces) of a point
+static inline float faceU(int face, float along) {
+  float f = along - floorf(along);
+  return face == FACE_WEST || face == FACE_SOUTH ? f : 1 - f;
+}
+
+struct lump {
+  uint32_t offset;
+  uint32_t length;
+};
+
+struct levelHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint16_t width;
+  uint16_t height;
+  uint32_t reserved;
+  struct lump lumps[LUMPS];
+};
+
+// an axis aligned piece of wall, seen from the side it faces
+struct bspSeg {
+  int16_t x0, y0;
+  int16_t x1, y1;
+  uint8_t face;
+  uint8_t pad;
+};
+
+// splits space along x == value (axis 0) or y == value
+// (axis 1), child[0] holds the smaller side. a child
+// below zero is leaf ~child, bbox is minX, minY, maxX,
+// maxY of everything under each child
+struct bspNode {
+  uint8_t axis;
+  uint8_t pad;
+  int16_t value;
+  int16_t bbox[2][4];
+  int32_t child[2];
+};
+
+// a convex set of segs, none of them hides another
+struct bspLeaf {
+  uint32_t firstSeg;
+  uint32_t numSegs;
+};
+
+// a loaded level, pointers go straight into the file
+struct level {
+  const struct levelHeader *header;
+  const char *grid;
+  const struct bspNode *nodes;
+  const struct bspLeaf *leaves;
+  const struct bspSeg *segs;
+  const uint8_t *pvs;
+  size_t pvsSize;
+  const uint8_t *lightmap;
+  int numNodes;
+  int numLeaves;
+  int numSegs;
+
+  void *data;
+  size_t size;
+  int mapped;
+};
+
+// reads a text map (rows of '#' and '.') into a
+// malloc'd grid, returns NULL on bad input
+char *readMapFile(const char *path, int *width, int *height);
+
+// walks the cells of a width by height grid between
+// two points, 0 if a wall is in the way before
+// reaching the second one. outside the grid is wall
+int lineOfSight(const char *grid, int width, int height, float fromX,
+                float fromY, float toX, float toY);
+
+// optional parts of a compiled level
+#define COMPILE_PVS 1
+#define COMPILE_LIGHTS 2
+
+struct pvsStats;
+
+// compiles a grid into a complete level file image in
+// malloc'd memory, returns NULL on failure. pvsStats
+// may be NULL
+void *compileLevel(const char *grid, int width, int height, int flags,
+                   size_t *size, struct pvsStats *pvsStats);
+
+// maps a compiled level file, returns 0 on success
+int openLevel(struct level *level, const char *path);
+
+// uses a level file image that is already in memory,
+// the level takes ownership of the buffer
+int useLevel(struct level *level, void *data, size_t size);
+
+void closeLevel(struct level *level);
+
+#endif
@@ -0,0 +1,119 @@
+/* Runtime side of wall lighting: the dynamic
+ * light grid and the light/distance shade table.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "light.h"
+#include "pvs.h"
+
+// distance steps in the shade table, across MAX_DEPTH
+#define LUT_DISTANCES 512
+
+// light steps in the shade table, light >> 4
+#define LIGHT_LEVELS 16
+
+static unsigned char shadeLUT[LUT_DISTANCES][LIGHT_LEVELS];
+
+// dynamic light per map cell, and the rectangle of
+// cells written last frame that needs clearing
+static uint8_t *lightGrid;
+static int gridCells;
+static int dirtyX0, dirtyY0, dirtyX1, dirtyY1;
+
+void buildShadeLUT() {
+  for (int d = 0; d < LUT_DISTANCES; d++) {
+    float distance = (d + 0.5f) * MAX_DEPTH / LUT_DISTANCES;
+    short base = shadeForDistance(distance);
+    for (int l = 0; l < LIGHT_LEVELS; l++) {
+      if (base == BLACK_ON_BLACK) {
+        // past the fog nothing is lit
+        shadeLUT[d][l] = BLACK_ON_BLACK;
+        continue;
+      }
+      int light = l * 256 / LIGHT_LEVELS + 256 / LIGHT_LEVELS / 2;
+      int shade = ((base - WALL_SHADE_START) * light + LIGHT_NEUTRAL / 2) /
+                  LIGHT_NEUTRAL;
+      if (shade > SHADES - 1)
+        shade = SHADES - 1;
+      shadeLUT[d][l] = WALL_SHADE_START + shade;
+    }
+  }
+}
+
+void updateLightGrid(const struct pointLight *lights, int count) {
+  if (gridCells != mapWidth * mapHeight) {
+    free(lightGrid);
+    gridCells = mapWidth * mapHeight;
+    lightGrid = calloc(gridCells, 1);
+    dirtyX1 = dirtyY1 = -1;
+  }
+
+  for (int y = dirtyY0; y <= dirtyY1; y++)
+    memset(lightGrid + y * mapWidth + dirtyX0, 0, dirtyX1 - dirtyX0 + 1);
+  dirtyX0 = mapWidth;
+  dirtyY0 = mapHeight;
+  dirtyX1 = dirtyY1 = -1;
+
+  for (int i = 0; i < count; i++) {
+    const struct pointLight *l = &lights[i];
+    int x0 = l->x - l->radius, x1 = l->x + l->radius;
+    int y0 = l->y - l->radius, y1 = l->y + l->radius;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > mapWidth - 1) x1 = mapWidth - 1;
+    if (y1 > mapHeight - 1) y1 = mapHeight - 1;
+    if (x0 < dirtyX0) dirtyX0 = x0;
+    if (y0 < dirtyY0) dirtyY0 = y0;
+    if (x1 > dirtyX1) dirtyX1 = x1;
+    if (y1 > dirtyY1) dirtyY1 = y1;
+
+    for (int y = y0; y <= y1; y++) {
+      for (int x = x0; x <= x1; x++) {
+        int cell = y * mapWidth + x;
+        if (!pvsTest(visibleCells, cell))
+          continue;
+        float dx = x + 0.5f - l->x;
+        float dy = y + 0.5f - l->y;
+        float dist2 = dx * dx + dy * dy;
+        if (dist2 >= l->radius * l->radius)
+          continue;
+        // (1 - d/r)^2 without the square root
+        float falloff = 1 - dist2 / (l->radius * l->radius);
+        int value = lightGrid[cell] + l->intensity * falloff * falloff;
+        lightGrid[cell] = value > 255 ? 255 : value;
+      }
+    }
+  }
+}
+
+short shadeForHit(const struct rayHit *hit) {
+  if (!level.lightmap || hit->cellX < 0)
+    return shadeForDistance(hit->distance);
+
+  int texel = hit->u * LIGHTMAP_RES;
+  if (texel < 0) texel = 0;
+  if (texel > LIGHTMAP_RES - 1) texel = LIGHTMAP_RES - 1;
+  int cell = hit->cellY * mapWidth + hit->cellX;
+  int light = level.lightmap[(cell * 4 + hit->face) * LIGHTMAP_RES + texel];
+
+  // dynamic light comes from the cell in front of the face
+  int frontX = hit->cellX, frontY = hit->cellY;
+  switch (hit->face) {
+    case FACE_WEST:  frontX--; break;
+    case FACE_EAST:  frontX++; break;
+    case FACE_NORTH: frontY--; break;
+    default:         frontY++; break;
+  }
+  if (lightGrid && frontX >= 0 && frontX < mapWidth &&
+      frontY >= 0 && frontY < mapHeight)
+    light += lightGrid[frontY * mapWidth + frontX];
+  if (light > 255)
+    light = 255;
+
+  int d = hit->distance * LUT_DISTANCES / MAX_DEPTH;
+  if (d > LUT_DISTANCES - 1)
+    d = LUT_DISTANCES - 1;
+  return shadeLUT[d][light >> 4];
+}
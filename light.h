@@ -0,0 +1,57 @@
+/* Wall lighting.
+ *
+ * Static lights ('*' cells in the map) are baked
+ * by the compiler into a lightmap of LIGHTMAP_RES
+ * texels for each of the four faces of every cell,
+ * indexed ((y * width + x) * 4 + face) * LIGHTMAP_RES.
+ * Dynamic point lights are splatted once a frame
+ * into a grid with one value per map cell, so a
+ * column finds its light with two array reads and
+ * turns light and distance into a color pair with
+ * one more read from a precomputed table.
+ */
+
+#ifndef LIGHT_H
+#define LIGHT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "doom_text.h"
+
+// texels across one wall face
+#define LIGHTMAP_RES 8
+
+// map character that marks a static light
+#define LIGHT_CHAR '*'
+
+// baked light on faces no light reaches
+#define LIGHT_AMBIENT 96
+
+// light value that leaves the distance shading as is
+#define LIGHT_NEUTRAL 128
+
+// how far a static light reaches, in cells
+#define LIGHT_RADIUS 8.0f
+
+// a moving light, intensity is 0 - 255
+struct pointLight {
+  float x, y;
+  float radius;
+  int intensity;
+};
+
+// bakes every static light into the lightmap lump
+void *bakeLightmaps(const char *grid, int width, int height, size_t *size);
+
+// builds the light/distance to color pair table
+void buildShadeLUT();
+
+// splats this frames dynamic lights into the light
+// grid, only cells in the visible set are touched
+void updateLightGrid(const struct pointLight *lights, int count);
+
+// color pair for a wall hit, including all lighting
+short shadeForHit(const struct rayHit *hit);
+
+#endif
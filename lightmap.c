@@ -0,0 +1,99 @@
+/* Lightmap baker, run by the level compiler.
+ *
+ * Every texel of every wall face that borders
+ * floor gets the ambient level plus the light of
+ * each static light that can see it, falling off
+ * with distance and the angle it arrives at.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "light.h"
+#include "fastmath.h"
+
+// how far texel samples sit out in front of the face
+#define SAMPLE_OFFSET 0.01f
+
+static int isSolid(const char *grid, int width, int height, int x, int y) {
+  if (x < 0 || x >= width || y < 0 || y >= height)
+    return 1;
+  return grid[y * width + x] == '#';
+}
+
+void *bakeLightmaps(const char *grid, int width, int height, size_t *size) {
+  int cells = width * height;
+  *size = (size_t) cells * 4 * LIGHTMAP_RES;
+  uint8_t *lightmap = malloc(*size);
+  memset(lightmap, LIGHT_AMBIENT, *size);
+
+  // light sources sit in the middle of their cell
+  int numLights = 0;
+  for (int i = 0; i < cells; i++)
+    numLights += grid[i] == LIGHT_CHAR;
+  float *lightX = malloc((numLights + 1) * sizeof(float));
+  float *lightY = malloc((numLights + 1) * sizeof(float));
+  numLights = 0;
+  for (int i = 0; i < cells; i++) {
+    if (grid[i] == LIGHT_CHAR) {
+      lightX[numLights] = i % width + 0.5f;
+      lightY[numLights++] = i / width + 0.5f;
+    }
+  }
+
+  // which way each face points
+  static const int normalX[4] = { -1, 1, 0, 0 };
+  static const int normalY[4] = { 0, 0, -1, 1 };
+
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      if (!isSolid(grid, width, height, x, y))
+        continue;
+      for (int face = 0; face < 4; face++) {
+        if (isSolid(grid, width, height,
+                    x + normalX[face], y + normalY[face]))
+          continue;
+
+        uint8_t *texels = lightmap +
+                          ((y * width + x) * 4 + face) * LIGHTMAP_RES;
+        for (int t = 0; t < LIGHTMAP_RES; t++) {
+          // texel centre on the face, see faceU()
+          float u = (t + 0.5f) / LIGHTMAP_RES;
+          float px, py;
+          switch (face) {
+            case FACE_WEST:  px = x;     py = y + u;     break;
+            case FACE_EAST:  px = x + 1; py = y + 1 - u; break;
+            case FACE_NORTH: px = x + 1 - u; py = y;     break;
+            default:         px = x + u; py = y + 1;     break;
+          }
+          px += normalX[face] * SAMPLE_OFFSET;
+          py += normalY[face] * SAMPLE_OFFSET;
+
+          float value = LIGHT_AMBIENT;
+          for (int l = 0; l < numLights; l++) {
+            float dx = lightX[l] - px;
+            float dy = lightY[l] - py;
+            float dist2 = dx * dx + dy * dy;
+            if (dist2 >= LIGHT_RADIUS * LIGHT_RADIUS)
+              continue;
+            float inverse = fastRsqrt(dist2);
+            float dist = dist2 * inverse;
+            float facing = (dx * normalX[face] + dy * normalY[face]) * inverse;
+            if (facing <= 0 ||
+                !lineOfSight(grid, width, height, lightX[l], lightY[l],
+                             px, py))
+              continue;
+            float falloff = 1 - dist / LIGHT_RADIUS;
+            value += 255 * falloff * falloff * facing;
+          }
+          texels[t] = value > 255 ? 255 : value;
+        }
+      }
+    }
+  }
+
+  free(lightX);
+  free(lightY);
+  return lightmap;
+}
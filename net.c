@@ -0,0 +1,119 @@
+/* Snapshot delta compression, shared by the
+ * server and the client.
+ */
+
+#include <string.h>
+
+#include "net.h"
+
+static const struct netEntity *findEntity(const struct snapshot *s, int id) {
+  if (!s)
+    return NULL;
+  for (int i = 0; i < s->count; i++)
+    if (s->entities[i].id == id)
+      return &s->entities[i];
+  return NULL;
+}
+
+size_t encodeEntities(uint8_t *out, size_t size, const struct snapshot *to,
+                      const struct snapshot *base) {
+  // worst case is every entity new plus the counts
+  if (size < 2 + (size_t) to->count * 8 + (base ? base->count : 0))
+    return 0;
+
+  uint8_t *p = out + 1;
+  int changed = 0;
+  for (int i = 0; i < to->count; i++) {
+    const struct netEntity *e = &to->entities[i];
+    const struct netEntity *old = findEntity(base, e->id);
+    int mask = FIELD_ALL;
+    if (old)
+      mask = (e->x != old->x ? FIELD_X : 0) |
+             (e->y != old->y ? FIELD_Y : 0) |
+             (e->a != old->a ? FIELD_A : 0);
+    if (!mask)
+      continue;
+
+    *p++ = e->id;
+    *p++ = mask;
+    if (mask & FIELD_X) { put16(p, e->x); p += 2; }
+    if (mask & FIELD_Y) { put16(p, e->y); p += 2; }
+    if (mask & FIELD_A) { put16(p, e->a); p += 2; }
+    changed++;
+  }
+  out[0] = changed;
+
+  uint8_t *removedCount = p++;
+  int removed = 0;
+  for (int i = 0; base && i < base->count; i++) {
+    if (!findEntity(to, base->entities[i].id)) {
+      *p++ = base->entities[i].id;
+      removed++;
+    }
+  }
+  *removedCount = removed;
+  return p - out;
+}
+
+// keeps a snapshot sorted by id after an insert
+static void insertEntity(struct snapshot *s, const struct netEntity *e) {
+  int i = s->count++;
+  while (i > 0 && s->entities[i - 1].id > e->id) {
+    s->entities[i] = s->entities[i - 1];
+    i--;
+  }
+  s->entities[i] = *e;
+}
+
+bool decodeEntities(const uint8_t *in, size_t size, struct snapshot *to,
+                    const struct snapshot *base) {
+  const uint8_t *end = in + size;
+  to->count = 0;
+  if (base) {
+    to->count = base->count;
+    memcpy(to->entities, base->entities,
+           base->count * sizeof(struct netEntity));
+  }
+
+  if (in >= end)
+    return false;
+  int changed = *in++;
+  for (int i = 0; i < changed; i++) {
+    if (end - in < 2)
+      return false;
+    int id = *in++;
+    int mask = *in++;
+    int fields = !!(mask & FIELD_X) + !!(mask & FIELD_Y) + !!(mask & FIELD_A);
+    if (end - in < fields * 2)
+      return false;
+
+    struct netEntity *e = (struct netEntity *) findEntity(to, id);
+    struct netEntity added = { id, 0, 0, 0 };
+    if (!e) {
+      if (mask != FIELD_ALL || to->count == MAX_ENTITIES)
+        return false;
+      e = &added;
+    }
+    if (mask & FIELD_X) { e->x = get16(in); in += 2; }
+    if (mask & FIELD_Y) { e->y = get16(in); in += 2; }
+    if (mask & FIELD_A) { e->a = get16(in); in += 2; }
+    if (e == &added)
+      insertEntity(to, &added);
+  }
+
+  if (in >= end)
+    return false;
+  int removed = *in++;
+  if (end - in < removed)
+    return false;
+  for (int i = 0; i < removed; i++) {
+    const struct netEntity *e = findEntity(to, *in++);
+    if (e) {
+      int index = e - to->entities;
+      memmove(&to->entities[index], &to->entities[index + 1],
+              (to->count - index - 1) * sizeof(struct netEntity));
+      to->count--;
+    }
+  }
+  return true;
+}
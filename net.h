@@ -0,0 +1,164 @@
+/* Multiplayer over UDP.
+ *
+ * The server owns the simulation and steps it
+ * NET_TICK_HZ times a second. Clients send their
+ * inputs (see player.h) numbered in sequence and
+ * predict their own movement by applying each one
+ * straight away. Every tick the server sends each
+ * client a snapshot of every entity, with position
+ * and angle quantised to 16 bits and delta
+ * compressed against the last snapshot that client
+ * acknowledged. A snapshot also says which of the
+ * clients inputs the server has played, so the
+ * client can take the servers word for where it
+ * is and replay the inputs that are still in
+ * flight on top.
+ *
+ * Packets are little endian:
+ *   hello     type
+ *   input     type, ack tick (4), first sequence (4),
+ *             count (1), count inputs (1 each)
+ *   snapshot  type, tick (4), base tick (4, 0 for a
+ *             full snapshot), last input played (4),
+ *             your entity id (1), entities
+ * and entities are a count of changed entities, each
+ * an id, a FIELD_* mask and the fields in the mask
+ * (2 bytes each), then a count of removed ids and
+ * the ids. Entities the base had that are not
+ * mentioned are unchanged.
+ */
+
+#ifndef NET_H
+#define NET_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "player.h"
+
+// simulation steps and snapshots a second
+#define NET_TICK_HZ 20
+
+// most entities in the world
+#define MAX_ENTITIES 64
+
+// snapshots kept on both ends to delta against
+#define NET_HISTORY 32
+
+// inputs a client may have in flight
+#define NET_MAX_INPUTS 32
+
+// largest datagram sent
+#define NET_PACKET 1400
+
+// seconds of silence before a client is dropped
+#define NET_TIMEOUT 5
+
+#define PACKET_HELLO 0
+#define PACKET_INPUT 1
+#define PACKET_SNAPSHOT 2
+
+// entity fields a delta can carry
+#define FIELD_X 1
+#define FIELD_Y 2
+#define FIELD_A 4
+#define FIELD_ALL (FIELD_X | FIELD_Y | FIELD_A)
+
+// widest and tallest map a server can run, as x
+// and y go out in 16 bits
+#define NET_MAP_MAX 256
+
+// an entity as it is sent, x and y in 1/256ths of
+// a cell and a in 1/65536ths of a turn
+struct netEntity {
+  uint8_t id;
+  uint16_t x, y, a;
+};
+
+// every entity at one tick, sorted by id
+struct snapshot {
+  uint32_t tick;
+  int count;
+  struct netEntity entities[MAX_ENTITIES];
+};
+
+// what a client measured over the last second
+struct clientStats {
+  int id;
+  int bytesPerSecond;
+  int snapshotsPerSecond;
+  float latencyMs;
+  int pendingInputs;
+};
+
+static inline struct netEntity quantiseEntity(int id,
+                                              const struct playerState *p) {
+  float turns = p->a / (2 * M_PI);
+  turns -= floorf(turns);
+  struct netEntity e = { id, p->x * 256, p->y * 256, turns * 65536 };
+  return e;
+}
+
+static inline struct playerState entityState(const struct netEntity *e) {
+  struct playerState p = {
+    e->x / 256.0f, e->y / 256.0f, e->a * (2 * M_PI) / 65536
+  };
+  return p;
+}
+
+// writes to as changes from base (NULL for a full
+// snapshot), returns the bytes used or 0 if there
+// was not enough room
+size_t encodeEntities(uint8_t *out, size_t size, const struct snapshot *to,
+                      const struct snapshot *base);
+
+// reads what encodeEntities wrote into to, false if
+// the data is malformed
+bool decodeEntities(const uint8_t *in, size_t size, struct snapshot *to,
+                    const struct snapshot *base);
+
+// little endian helpers shared by both ends
+static inline void put16(uint8_t *p, uint16_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static inline void put32(uint8_t *p, uint32_t v) {
+  put16(p, v);
+  put16(p + 2, v >> 16);
+}
+
+static inline uint16_t get16(const uint8_t *p) {
+  return p[0] | p[1] << 8;
+}
+
+static inline uint32_t get32(const uint8_t *p) {
+  return get16(p) | (uint32_t) get16(p + 2) << 16;
+}
+
+// runs a headless server on port with some bots
+// wandering the map until killed
+int runServer(int port, int bots);
+
+// starts talking to the server at host:port
+int startClient(const char *address);
+
+// sends an input, false if too many are in flight
+// already and it should not be applied either
+bool clientInput(int input);
+
+// sends and receives, and moves self to where the
+// server says it is plus the inputs still in flight
+void clientUpdate(struct playerState *self);
+
+// the other entities in the latest snapshot,
+// returns how many were written to out
+int clientEntities(struct netEntity *out);
+
+void clientReport(struct clientStats *stats);
+
+void stopClient();
+
+#endif
@@ -0,0 +1,88 @@
+/* Player movement against the map grid. */
+
+#include <math.h>
+
+#include "doom_text.h"
+#include "player.h"
+#include "fixed.h"
+#include "fastmath.h"
+
+// applyInput's moves in fixed point, newX and newY
+// come out exact
+static void fixedMove(struct playerState *p, int input, float *newX,
+                      float *newY) {
+  fixed x = toFixed(p->x);
+  fixed y = toFixed(p->y);
+  uint32_t a = toAngle(p->a);
+  fixed c = fixedCos(a);
+  fixed s = fixedSin(a);
+  switch (input) {
+    case INPUT_FORWARD:
+      x += c;
+      y += s;
+      break;
+    case INPUT_LEFT:
+      x += s;
+      y -= c;
+      break;
+    case INPUT_BACK:
+      x -= c;
+      y -= s;
+      break;
+    case INPUT_RIGHT:
+      x -= s;
+      y += c;
+      break;
+    case INPUT_TURN_LEFT:
+      a -= ANGLE_QUARTER / 16;
+      break;
+    case INPUT_TURN_RIGHT:
+      a += ANGLE_QUARTER / 16;
+      break;
+  }
+  p->a = fromAngle(a);
+  *newX = fromFixed(x);
+  *newY = fromFixed(y);
+}
+
+void applyInput(struct playerState *p, int input) {
+  float newX = p->x;
+  float newY = p->y;
+  if (fixedMath) {
+    fixedMove(p, input, &newX, &newY);
+  } else {
+    float s, c;
+    fastSinCos(p->a, &s, &c);
+    switch (input) {
+      case INPUT_FORWARD:
+        newX = p->x + c;
+        newY = p->y + s;
+        break;
+      case INPUT_LEFT:
+        newX = p->x + s;
+        newY = p->y - c;
+        break;
+      case INPUT_BACK:
+        newX = p->x - c;
+        newY = p->y - s;
+        break;
+      case INPUT_RIGHT:
+        newX = p->x - s;
+        newY = p->y + c;
+        break;
+      case INPUT_TURN_LEFT:
+        p->a -= M_PI / 32.0;
+        break;
+      case INPUT_TURN_RIGHT:
+        p->a += M_PI / 32.0;
+        break;
+    }
+  }
+
+  /* collision detection */
+  if (newX >= 0 && newX < mapWidth && newY >= 0 && newY < mapHeight &&
+      map[(int) newY * mapWidth + (int) newX] != '#') {
+    p->x = newX;
+    p->y = newY;
+  }
+}
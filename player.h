@@ -0,0 +1,32 @@
+/* Player movement.
+ *
+ * Every move goes through applyInput, so the same
+ * code moves the local player when a key is hit,
+ * the server when it plays a clients inputs, and
+ * the client when it replays the inputs the server
+ * has not seen yet on top of a snapshot.
+ */
+
+#ifndef PLAYER_H
+#define PLAYER_H
+
+// where a player is and which way it faces
+struct playerState {
+  float x, y;
+  float a;
+};
+
+// inputs, one per key press
+#define INPUT_NONE 0
+#define INPUT_FORWARD 1
+#define INPUT_BACK 2
+#define INPUT_LEFT 3
+#define INPUT_RIGHT 4
+#define INPUT_TURN_LEFT 5
+#define INPUT_TURN_RIGHT 6
+#define INPUTS 7
+
+// moves or turns a player, walls block moves
+void applyInput(struct playerState *p, int input);
+
+#endif
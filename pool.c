@@ -0,0 +1,121 @@
+/* Worker pool. Each runPool call is a new
+ * generation of jobs; workers sleep until the
+ * generation changes, then take job indices under
+ * the lock until none are left. Jobs are few and
+ * large (a whole view), so one lock is plenty.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done = PTHREAD_COND_INITIALIZER;
+
+static pthread_t *workers;
+static int numWorkers;
+static bool stopping;
+
+// this threads place in the pool
+static __thread int thread;
+
+// the current generation of jobs
+static void (*jobFn)(int, void *);
+static void *jobArg;
+static int jobCount;
+static int nextJob;
+static int finished;
+static int generation;
+
+// runs jobs of generation gen until there are none
+// left, called and returns with the lock held
+static void runJobs(int gen) {
+  while (generation == gen && nextJob < jobCount) {
+    int index = nextJob++;
+    void (*fn)(int, void *) = jobFn;
+    void *arg = jobArg;
+    pthread_mutex_unlock(&lock);
+    fn(index, arg);
+    pthread_mutex_lock(&lock);
+    if (++finished == jobCount)
+      pthread_cond_signal(&done);
+  }
+}
+
+static void *poolWorker(void *index) {
+  thread = (intptr_t) index;
+  int seen = 0;
+  pthread_mutex_lock(&lock);
+  while (!stopping) {
+    if (generation != seen) {
+      seen = generation;
+      runJobs(seen);
+    } else {
+      pthread_cond_wait(&wake, &lock);
+    }
+  }
+  pthread_mutex_unlock(&lock);
+  return NULL;
+}
+
+void startPool() {
+  int threads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+  if (threads < 0)
+    threads = 0;
+  workers = malloc((threads + 1) * sizeof(pthread_t));
+  numWorkers = 0;
+  for (int i = 0; i < threads; i++)
+    if (pthread_create(&workers[numWorkers], NULL, poolWorker,
+                       (void *) (intptr_t) (numWorkers + 1)) == 0)
+      numWorkers++;
+}
+
+void submitPool(void (*job)(int index, void *arg), int count, void *arg) {
+  pthread_mutex_lock(&lock);
+  jobFn = job;
+  jobArg = arg;
+  jobCount = count;
+  nextJob = 0;
+  finished = 0;
+  generation++;
+  pthread_cond_broadcast(&wake);
+  pthread_mutex_unlock(&lock);
+}
+
+void waitPool() {
+  pthread_mutex_lock(&lock);
+  runJobs(generation);
+  while (finished < jobCount)
+    pthread_cond_wait(&done, &lock);
+  pthread_mutex_unlock(&lock);
+}
+
+void runPool(void (*job)(int index, void *arg), int count, void *arg) {
+  submitPool(job, count, arg);
+  waitPool();
+}
+
+void stopPool() {
+  pthread_mutex_lock(&lock);
+  stopping = true;
+  pthread_cond_broadcast(&wake);
+  pthread_mutex_unlock(&lock);
+  for (int i = 0; i < numWorkers; i++)
+    pthread_join(workers[i], NULL);
+  free(workers);
+  workers = NULL;
+  numWorkers = 0;
+}
+
+int poolThreads() {
+  return numWorkers + 1;
+}
+
+int poolThread() {
+  return thread;
+}
@@ -0,0 +1,35 @@
+/* A fixed pool of worker threads for per frame
+ * jobs, such as rendering each camera's view.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+// starts one worker per core, less the caller
+void startPool();
+
+// runs job(0 .. count - 1, arg) across the pool and
+// the calling thread, returns once all are done
+void runPool(void (*job)(int index, void *arg), int count, void *arg);
+
+// hands the same jobs to the workers and returns at
+// once, so the caller can get on with something
+// else; waitPool has to come before the next jobs
+void submitPool(void (*job)(int index, void *arg), int count, void *arg);
+
+// runs whatever the workers have not taken on the
+// calling thread, returns once all are done
+void waitPool();
+
+// stops and joins every worker
+void stopPool();
+
+// how many threads runPool runs jobs on, the
+// workers and the caller
+int poolThreads();
+
+// which of those the calling thread is, 0 for the
+// thread that started the pool
+int poolThread();
+
+#endif
@@ -0,0 +1,254 @@
+/* Sector/portal renderer.
+ *
+ * Floor cells are greedily merged into axis
+ * aligned rectangles. Every side of a rectangle
+ * is cut into edges which are either solid wall
+ * or a portal into a neighbouring sector. To draw
+ * a frame we start in the cameras sector with the
+ * whole view as the column window, find where
+ * each columns ray leaves the sector, draw walls
+ * directly and recurse through portals with the
+ * window clipped to the columns that see them.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "doom_text.h"
+#include "portal.h"
+#include "resize.h"
+#include "fastmath.h"
+
+// guards against rays bouncing between sectors
+// on floating point edge cases
+#define MAX_PORTAL_DEPTH 64
+
+// sides of a sector
+#define WEST 0
+#define EAST 1
+#define NORTH 2
+#define SOUTH 3
+
+// one stretch of a sector side, from/to run along
+// the side, sector is -1 for solid wall
+struct edge {
+  int from, to;
+  int sector;
+};
+
+// a convex room covering cells [x0, x1) x [y0, y1)
+struct sector {
+  int x0, y0, x1, y1;
+  int edgeStart[4];
+  int edgeCount[4];
+};
+
+static struct sector *sectors;
+static struct edge *edges;
+static int *sectorOf;
+static int numSectors;
+static int numEdges;
+
+// per frame state, one per rendering thread
+static __thread struct view *view;
+static __thread float *rayX;
+static __thread float *rayY;
+static __thread int visited;
+
+static bool isFloor(int x, int y) {
+  if (x < 0 || x >= mapWidth || y < 0 || y >= mapHeight)
+    return false;
+  return map[y * mapWidth + x] != '#';
+}
+
+static int neighbourSector(int x, int y) {
+  return isFloor(x, y) ? sectorOf[y * mapWidth + x] : -1;
+}
+
+// cuts one side of a sector into edges, merging
+// neighbouring cells that lead to the same place
+static void buildSide(struct sector *s, int side) {
+  s->edgeStart[side] = numEdges;
+  int from = (side == WEST || side == EAST) ? s->y0 : s->x0;
+  int to = (side == WEST || side == EAST) ? s->y1 : s->x1;
+
+  for (int i = from; i < to; i++) {
+    int target;
+    switch (side) {
+      case WEST:  target = neighbourSector(s->x0 - 1, i); break;
+      case EAST:  target = neighbourSector(s->x1, i);     break;
+      case NORTH: target = neighbourSector(i, s->y0 - 1); break;
+      default:    target = neighbourSector(i, s->y1);     break;
+    }
+
+    if (numEdges > s->edgeStart[side] &&
+        edges[numEdges - 1].sector == target) {
+      edges[numEdges - 1].to = i + 1;
+    } else {
+      edges[numEdges].from = i;
+      edges[numEdges].to = i + 1;
+      edges[numEdges].sector = target;
+      numEdges++;
+    }
+  }
+  s->edgeCount[side] = numEdges - s->edgeStart[side];
+}
+
+void buildSectors() {
+  int cells = mapWidth * mapHeight;
+  free(sectors);
+  free(edges);
+  free(sectorOf);
+  sectors = malloc(cells * sizeof(struct sector));
+  edges = malloc(4 * cells * sizeof(struct edge));
+  sectorOf = malloc(cells * sizeof(int));
+  numSectors = 0;
+  numEdges = 0;
+
+  for (int i = 0; i < cells; i++)
+    sectorOf[i] = -1;
+
+  // grow each unclaimed floor cell right, then down
+  for (int y = 0; y < mapHeight; y++) {
+    for (int x = 0; x < mapWidth; x++) {
+      if (!isFloor(x, y) || sectorOf[y * mapWidth + x] != -1)
+        continue;
+
+      int x1 = x;
+      while (x1 < mapWidth && isFloor(x1, y) &&
+             sectorOf[y * mapWidth + x1] == -1)
+        x1++;
+
+      int y1 = y + 1;
+      while (y1 < mapHeight) {
+        bool rowFree = true;
+        for (int i = x; i < x1 && rowFree; i++)
+          rowFree = isFloor(i, y1) && sectorOf[y1 * mapWidth + i] == -1;
+        if (!rowFree)
+          break;
+        y1++;
+      }
+
+      struct sector *s = &sectors[numSectors];
+      s->x0 = x;
+      s->y0 = y;
+      s->x1 = x1;
+      s->y1 = y1;
+      for (int j = y; j < y1; j++)
+        for (int i = x; i < x1; i++)
+          sectorOf[j * mapWidth + i] = numSectors;
+      numSectors++;
+    }
+  }
+
+  // sides can only be cut once every cell has a sector
+  for (int i = 0; i < numSectors; i++)
+    for (int side = 0; side < 4; side++)
+      buildSide(&sectors[i], side);
+}
+
+int sectorCount() {
+  return numSectors;
+}
+
+// finds the edge a ray leaves sector s through, and
+// fills in where it hits should that edge be wall
+static const struct edge *exitEdge(const struct sector *s,
+                                   float unitX, float unitY,
+                                   struct rayHit *hit) {
+  float x = view->cam.x;
+  float y = view->cam.y;
+  float tx = INFINITY;
+  float ty = INFINITY;
+  if (unitX > 0) tx = (s->x1 - x) / unitX;
+  if (unitX < 0) tx = (s->x0 - x) / unitX;
+  if (unitY > 0) ty = (s->y1 - y) / unitY;
+  if (unitY < 0) ty = (s->y0 - y) / unitY;
+
+  int side;
+  float along;
+  if (tx < ty) {
+    side = unitX > 0 ? EAST : WEST;
+    hit->distance = tx;
+    along = y + tx * unitY;
+    hit->cellX = unitX > 0 ? s->x1 : s->x0 - 1;
+    hit->cellY = floorf(along);
+    hit->face = unitX > 0 ? FACE_WEST : FACE_EAST;
+  } else {
+    side = unitY > 0 ? SOUTH : NORTH;
+    hit->distance = ty;
+    along = x + ty * unitX;
+    hit->cellX = floorf(along);
+    hit->cellY = unitY > 0 ? s->y1 : s->y0 - 1;
+    hit->face = unitY > 0 ? FACE_NORTH : FACE_SOUTH;
+  }
+  hit->u = faceU(hit->face, along);
+
+  // edges are sorted along the side, past the
+  // ends (rounding) falls back to the first/last
+  const struct edge *e = &edges[s->edgeStart[side]];
+  int count = s->edgeCount[side];
+  for (int i = 0; i < count - 1; i++) {
+    if (along < e[i].to)
+      return &e[i];
+  }
+  return &e[count - 1];
+}
+
+static void renderSector(int s, int c0, int c1, int h, int depth) {
+  visited++;
+  const struct sector *sec = &sectors[s];
+
+  int runStart = c0;
+  int runSector = -1;
+  for (int col = c0; col <= c1; col++) {
+    int target = -1;
+    struct rayHit hit;
+    if (col < c1) {
+      const struct edge *e = exitEdge(sec, rayX[col], rayY[col], &hit);
+      target = e->sector;
+      if (hit.distance >= MAX_DEPTH || depth >= MAX_PORTAL_DEPTH)
+        target = -1;
+    }
+
+    // flush the run of columns looking through one portal
+    if (target != runSector || col == c1) {
+      if (runSector != -1)
+        renderSector(runSector, runStart, col, h, depth + 1);
+      runStart = col;
+      runSector = target;
+    }
+
+    if (col < c1 && target == -1) {
+      if (hit.distance >= MAX_DEPTH) {
+        hit.distance = MAX_DEPTH;
+        hit.cellX = -1;
+      }
+      hit.steps = depth + 1;
+      drawColumn(view, col, h, &hit);
+    }
+  }
+}
+
+int renderPortals(struct view *v, int w, int h) {
+  view = v;
+  struct scratch *s = threadScratch();
+  rayX = s->rayX;
+  rayY = s->rayY;
+
+  const struct camera *cam = &v->cam;
+  rayDirections(rayX, rayY, cam->a - cam->fov / 2, cam->fov / w, w);
+
+  visited = 0;
+  int start = neighbourSector((int) cam->x, (int) cam->y);
+  if (start == -1) {
+    // inside a wall, nothing sensible to see
+    struct rayHit none = { MAX_DEPTH, -1, -1, 0, 0, 0 };
+    for (int col = 0; col < w; col++)
+      drawColumn(v, col, h, &none);
+    return 0;
+  }
+
+  renderSector(start, 0, w, h, 0);
+  return visited;
+}
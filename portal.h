@@ -0,0 +1,22 @@
+/* Sector/portal renderer. The map is split into
+ * convex (rectangular) sectors joined by portals,
+ * and each frame is drawn by walking from the
+ * cameras sector through the portals it can see.
+ */
+
+#ifndef PORTAL_H
+#define PORTAL_H
+
+#include "doom_text.h"
+
+// splits the map into sectors, call once before rendering
+void buildSectors();
+
+// number of sectors the map was split into
+int sectorCount();
+
+// draws every column of a view, returns how many
+// sectors were visited for this frame
+int renderPortals(struct view *v, int w, int h);
+
+#endif
@@ -0,0 +1,256 @@
+/* ptybench - end to end terminal benchmark.
+ *
+ * Usage: ptybench [-f frames] [-s COLSxROWS] [-k keys]
+ *                 [-- app arguments]
+ *
+ * Runs ./app on a pseudo terminal the way a user
+ * would and reads everything it writes through the
+ * terminal parser in vt.h, so the cost measured is
+ * what the terminal sees rather than what the
+ * renderer thinks it sent.
+ *
+ * First the app runs for a fixed number of frames
+ * (--frames) while the keys are sent over and over,
+ * giving frames a second and bytes per frame. Then
+ * a fresh app is sent each key in turn (L and R
+ * stand for the arrow keys) and timed until
+ * everything above the debug line stops changing,
+ * and the settled screen is checked for exactly one
+ * player marker on the minimap and the debug line.
+ */
+
+#define _GNU_SOURCE
+
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "vt.h"
+#include "clock.h"
+
+// how long the screen must hold still to count as
+// settled after a key
+#define SETTLE_MS 100
+
+// longest wait for a key to settle
+#define KEY_TIMEOUT_MS 2000
+
+// time between keys in the throughput run
+#define KEY_INTERVAL_MS 10
+
+#define MAX_ARGS 32
+
+// starts ./app with args on a w x h pty, returns the
+// master side
+static int spawn(char **args, int w, int h, pid_t *pid) {
+  struct winsize size = { h, w, 0, 0 };
+  int fd;
+  *pid = forkpty(&fd, NULL, NULL, &size);
+  if (*pid < 0) {
+    perror("forkpty");
+    return -1;
+  }
+  if (*pid == 0) {
+    setenv("TERM", "xterm-256color", 1);
+    execv(args[0], args);
+    perror(args[0]);
+    _exit(127);
+  }
+  return fd;
+}
+
+// feeds output into vt for up to timeout ms, returns
+// the bytes read or -1 once the app has gone
+static long drain(int fd, struct vt *vt, int timeout) {
+  struct pollfd p = { fd, POLLIN, 0 };
+  if (poll(&p, 1, timeout) <= 0)
+    return 0;
+  char buffer[65536];
+  ssize_t n = read(fd, buffer, sizeof(buffer));
+  if (n <= 0)
+    return -1;
+  vtFeed(vt, buffer, n);
+  return n;
+}
+
+static void finish(int fd, pid_t pid) {
+  int status;
+  close(fd);
+  waitpid(pid, &status, 0);
+}
+
+// the player is on the minimap once and the debug
+// line is at the bottom
+static bool checkScreen(const struct vt *vt) {
+  char line[vt->w + 1];
+  int markers = 0;
+  for (int row = 0; row < vt->h - 1; row++) {
+    vtRow(vt, row, line);
+    for (char *p = line; (p = strchr(p, '@')); p++)
+      markers++;
+  }
+  vtRow(vt, vt->h - 1, line);
+  bool debug = strncmp(line, "Angle:", 6) == 0;
+  printf("screen: %s (%d player markers, debug line %s)\n",
+         markers == 1 && debug ? "ok" : "WRONG", markers,
+         debug ? "found" : "missing");
+  return markers == 1 && debug;
+}
+
+// sends key, the arrows as the escape sequences
+// the keypad sends
+static int sendKey(int fd, char key) {
+  if (key == 'L')
+    return write(fd, "\x1bOD", 3);
+  if (key == 'R')
+    return write(fd, "\x1bOC", 3);
+  return write(fd, &key, 1);
+}
+
+static bool throughput(char **args, int w, int h, int frames,
+                       const char *keys) {
+  struct vt vt;
+  vtOpen(&vt, w, h);
+  pid_t pid;
+  double start = now();
+  int fd = spawn(args, w, h, &pid);
+  if (fd < 0)
+    return false;
+
+  long bytes = 0, n;
+  double nextKey = start;
+  const char *key = keys;
+  while ((n = drain(fd, &vt, KEY_INTERVAL_MS)) >= 0) {
+    bytes += n;
+    if (*keys && now() >= nextKey) {
+      sendKey(fd, *key);
+      key = key[1] ? key + 1 : keys;
+      nextKey += KEY_INTERVAL_MS / 1000.0;
+    }
+  }
+  double seconds = now() - start;
+  finish(fd, pid);
+  vtClose(&vt);
+
+  printf("throughput: %d frames in %.2fs, %.0f fps, %.0f bytes/frame, "
+         "%.1f MB/s\n", frames, seconds, frames / seconds,
+         (double) bytes / frames, bytes / seconds / 1e6);
+  return true;
+}
+
+// reads until the screen above the debug line has
+// held still for SETTLE_MS. returns 1 and when it
+// last changed in changed, 0 if it never changed or
+// -1 if it never settled
+static int settle(int fd, struct vt *vt, double *changed) {
+  double start = now();
+  double last = start;
+  int result = 0;
+  uint64_t hash = vtHash(vt, 0, vt->h - 1);
+  while (now() - last < SETTLE_MS / 1000.0) {
+    if (now() - start > KEY_TIMEOUT_MS / 1000.0)
+      return -1;
+    if (drain(fd, vt, 10) < 0)
+      return -1;
+    uint64_t next = vtHash(vt, 0, vt->h - 1);
+    if (next != hash) {
+      hash = next;
+      last = now();
+      result = 1;
+    }
+  }
+  *changed = last;
+  return result;
+}
+
+static bool stabilise(char **args, int w, int h, const char *keys) {
+  struct vt vt;
+  vtOpen(&vt, w, h);
+  pid_t pid;
+  int fd = spawn(args, w, h, &pid);
+  if (fd < 0)
+    return false;
+
+  double changed;
+  bool ok = settle(fd, &vt, &changed) >= 0;
+  double total = 0, worst = 0;
+  int timed = 0, still = 0;
+  for (const char *k = keys; ok && *k; k++) {
+    double sent = now();
+    if (sendKey(fd, *k) < 0)
+      break;
+    int result = settle(fd, &vt, &changed);
+    if (result < 0) {
+      ok = false;
+    } else if (result == 0) {
+      still++;
+    } else {
+      total += changed - sent;
+      if (changed - sent > worst)
+        worst = changed - sent;
+      timed++;
+    }
+  }
+  if (!ok) {
+    printf("stabilise: the screen never settled\n");
+  } else {
+    printf("stabilise: %d keys, mean %.1fms, max %.1fms, "
+           "%d changed nothing\n", timed, timed ? total / timed * 1000 : 0,
+           worst * 1000, still);
+    ok = checkScreen(&vt);
+  }
+
+  if (write(fd, "q", 1) < 0)
+    kill(pid, SIGTERM);
+  finish(fd, pid);
+  vtClose(&vt);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  int frames = 500;
+  int w = 120, h = 40;
+  const char *keys = "wwwwRRRRddLLLLssaa";
+  char *args[MAX_ARGS] = { "./app" };
+  int numArgs = 1;
+
+  int i;
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+      frames = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc &&
+               sscanf(argv[i + 1], "%dx%d", &w, &h) == 2) {
+      i++;
+    } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+      keys = argv[++i];
+    } else if (strcmp(argv[i], "--") == 0) {
+      break;
+    } else {
+      fprintf(stderr, "usage: %s [-f frames] [-s COLSxROWS] [-k keys] "
+              "[-- app arguments]\n", argv[0]);
+      return 1;
+    }
+  }
+  for (i++; i < argc && numArgs < MAX_ARGS - 3; i++)
+    args[numArgs++] = argv[i];
+
+  // the stabilise run has no frame limit
+  char count[16];
+  snprintf(count, sizeof(count), "%d", frames);
+  args[numArgs] = NULL;
+  char *timedArgs[MAX_ARGS];
+  memcpy(timedArgs, args, sizeof(args));
+  timedArgs[numArgs] = "--frames";
+  timedArgs[numArgs + 1] = count;
+  timedArgs[numArgs + 2] = NULL;
+
+  bool ok = throughput(timedArgs, w, h, frames, keys);
+  ok = stabilise(args, w, h, keys) && ok;
+  return ok ? 0 : 1;
+}
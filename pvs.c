@@ -0,0 +1,230 @@
+/* Potentially visible set builder.
+ *
+ * From a grid of sample points inside each floor
+ * cell we cast a fan of rays and walk them cell
+ * by cell (DDA) until they hit a wall, marking
+ * every cell on the way. Cells are handed out to
+ * one worker thread per core.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pvs.h"
+
+// sample points sit on a grid running edge to edge,
+// just pulled in from the cell border
+#define PVS_INSET 0.001f
+
+struct pvsJob {
+  const char *grid;
+  int width;
+  int height;
+  int nextCell;
+
+  // compressed row and its length for every cell
+  uint8_t **rows;
+  int *rowLengths;
+  long *visibleCounts;
+};
+
+static int isSolid(const struct pvsJob *job, int x, int y) {
+  return job->grid[y * job->width + x] == '#';
+}
+
+// marks every cell a ray passes until it is stopped
+static void castRay(const struct pvsJob *job, float originX, float originY,
+                    float unitX, float unitY, uint8_t *row) {
+  int mapX = (int) originX;
+  int mapY = (int) originY;
+  float deltaX = unitX == 0 ? INFINITY : fabsf(1 / unitX);
+  float deltaY = unitY == 0 ? INFINITY : fabsf(1 / unitY);
+  int stepX = unitX < 0 ? -1 : 1;
+  int stepY = unitY < 0 ? -1 : 1;
+  float sideX = (unitX < 0 ? originX - mapX : mapX + 1 - originX) * deltaX;
+  float sideY = (unitY < 0 ? originY - mapY : mapY + 1 - originY) * deltaY;
+
+  while (1) {
+    int cell = mapY * job->width + mapX;
+    row[cell >> 3] |= 1 << (cell & 7);
+    if (isSolid(job, mapX, mapY))
+      return;
+
+    if (sideX < sideY) {
+      sideX += deltaX;
+      mapX += stepX;
+    } else {
+      sideY += deltaY;
+      mapY += stepY;
+    }
+    if (mapX < 0 || mapX >= job->width || mapY < 0 || mapY >= job->height)
+      return;
+  }
+}
+
+// zero bytes become a zero followed by a run length
+static int compressRow(const uint8_t *row, int length, uint8_t *out) {
+  int n = 0;
+  for (int i = 0; i < length; i++) {
+    if (row[i]) {
+      out[n++] = row[i];
+      continue;
+    }
+    int run = 1;
+    while (i + run < length && row[i + run] == 0 && run < 255)
+      run++;
+    out[n++] = 0;
+    out[n++] = run;
+    i += run - 1;
+  }
+  return n;
+}
+
+static void *pvsWorker(void *arg) {
+  struct pvsJob *job = arg;
+  int cells = job->width * job->height;
+  int rowBytes = pvsRowBytes(job->width, job->height);
+  uint8_t *row = malloc(rowBytes);
+  uint8_t *packed = malloc(2 * rowBytes);
+
+  float unitX[PVS_RAYS], unitY[PVS_RAYS];
+  for (int i = 0; i < PVS_RAYS; i++) {
+    unitX[i] = cos(2 * M_PI * i / PVS_RAYS);
+    unitY[i] = sin(2 * M_PI * i / PVS_RAYS);
+  }
+
+  while (1) {
+    int cell = __atomic_fetch_add(&job->nextCell, 1, __ATOMIC_RELAXED);
+    if (cell >= cells)
+      break;
+    int x = cell % job->width;
+    int y = cell / job->width;
+    if (isSolid(job, x, y))
+      continue;
+
+    memset(row, 0, rowBytes);
+    float step = (1 - 2 * PVS_INSET) / (PVS_SAMPLES - 1);
+    for (int sy = 0; sy < PVS_SAMPLES; sy++) {
+      for (int sx = 0; sx < PVS_SAMPLES; sx++) {
+        float originX = x + PVS_INSET + sx * step;
+        float originY = y + PVS_INSET + sy * step;
+        for (int i = 0; i < PVS_RAYS; i++)
+          castRay(job, originX, originY, unitX[i], unitY[i], row);
+      }
+    }
+
+    long visible = 0;
+    for (int i = 0; i < rowBytes; i++)
+      visible += __builtin_popcount(row[i]);
+    int length = compressRow(row, rowBytes, packed);
+    job->rows[cell] = malloc(length);
+    memcpy(job->rows[cell], packed, length);
+    job->rowLengths[cell] = length;
+    job->visibleCounts[cell] = visible;
+  }
+
+  free(row);
+  free(packed);
+  return NULL;
+}
+
+void *buildPVS(const char *grid, int width, int height, size_t *size,
+               struct pvsStats *stats) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  int cells = width * height;
+  struct pvsJob job;
+  job.grid = grid;
+  job.width = width;
+  job.height = height;
+  job.nextCell = 0;
+  job.rows = calloc(cells, sizeof(uint8_t *));
+  job.rowLengths = calloc(cells, sizeof(int));
+  job.visibleCounts = calloc(cells, sizeof(long));
+
+  int threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads < 1)
+    threads = 1;
+  pthread_t *workers = malloc(threads * sizeof(pthread_t));
+  int started = 0;
+  for (int i = 0; i < threads; i++)
+    if (pthread_create(&workers[started], NULL, pvsWorker, &job) == 0)
+      started++;
+  if (started == 0)
+    pvsWorker(&job);
+  for (int i = 0; i < started; i++)
+    pthread_join(workers[i], NULL);
+  free(workers);
+
+  // offsets table, then the rows back to back
+  size_t tableBytes = cells * sizeof(uint32_t);
+  size_t total = tableBytes;
+  for (int i = 0; i < cells; i++)
+    total += job.rowLengths[i];
+
+  uint8_t *lump = malloc(total);
+  uint32_t *offsets = (uint32_t *) lump;
+  size_t at = tableBytes;
+  long visible = 0;
+  int floors = 0;
+  for (int i = 0; i < cells; i++) {
+    if (!job.rows[i]) {
+      offsets[i] = PVS_NONE;
+      continue;
+    }
+    offsets[i] = at;
+    memcpy(lump + at, job.rows[i], job.rowLengths[i]);
+    at += job.rowLengths[i];
+    visible += job.visibleCounts[i];
+    floors++;
+    free(job.rows[i]);
+  }
+  free(job.rows);
+  free(job.rowLengths);
+  free(job.visibleCounts);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  if (stats) {
+    stats->seconds = (end.tv_sec - start.tv_sec) +
+                     (end.tv_nsec - start.tv_nsec) / 1e9;
+    stats->threads = started ? started : 1;
+    stats->rawBytes = tableBytes + (size_t) floors * pvsRowBytes(width, height);
+    stats->compressedBytes = total;
+    stats->visibleFraction = floors ? (double) visible / floors / cells : 0;
+  }
+  *size = total;
+  return lump;
+}
+
+void decompressPVS(const struct level *level, int cell, uint8_t *row) {
+  int rowBytes = pvsRowBytes(level->header->width, level->header->height);
+  const uint32_t *offsets = (const uint32_t *) level->pvs;
+  if (!level->pvs || offsets[cell] == PVS_NONE) {
+    memset(row, 0xff, rowBytes);
+    return;
+  }
+
+  const uint8_t *in = level->pvs + offsets[cell];
+  const uint8_t *end = level->pvs + level->pvsSize;
+  int i = 0;
+  while (i < rowBytes && in < end) {
+    if (*in) {
+      row[i++] = *in++;
+      continue;
+    }
+    int run = in + 1 < end ? in[1] : rowBytes - i;
+    if (run > rowBytes - i)
+      run = rowBytes - i;
+    memset(row + i, 0, run);
+    i += run;
+    in += 2;
+  }
+  // a truncated row is filled in as visible
+  if (i < rowBytes)
+    memset(row + i, 0xff, rowBytes - i);
+}
@@ -0,0 +1,56 @@
+/* Potentially visible sets.
+ *
+ * For every floor cell the compiler stores a
+ * bitmap of all cells that can be seen from
+ * somewhere inside it. The PVS lump starts with
+ * one uint32_t offset per cell (PVS_NONE for
+ * walls) into the compressed rows that follow.
+ * Rows are run length encoded the Quake way: a
+ * zero byte is followed by how many zero bytes
+ * it stands for.
+ */
+
+#ifndef PVS_H
+#define PVS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "level.h"
+
+#define PVS_NONE 0xffffffffu
+
+// sample points per cell along each axis, at least 2
+#define PVS_SAMPLES 3
+
+// rays cast from every sample point
+#define PVS_RAYS 1024
+
+// what building the PVS cost and produced
+struct pvsStats {
+  double seconds;
+  int threads;
+  size_t rawBytes;
+  size_t compressedBytes;
+  double visibleFraction;
+};
+
+// bytes in one uncompressed row
+static inline int pvsRowBytes(int width, int height) {
+  return (width * height + 7) / 8;
+}
+
+static inline int pvsTest(const uint8_t *row, int cell) {
+  return row[cell >> 3] >> (cell & 7) & 1;
+}
+
+// casts rays from every floor cell on all cores and
+// returns the malloc'd lump
+void *buildPVS(const char *grid, int width, int height, size_t *size,
+               struct pvsStats *stats);
+
+// fills row with the cells visible from cell, levels
+// without a PVS see everything
+void decompressPVS(const struct level *level, int cell, uint8_t *row);
+
+#endif
@@ -0,0 +1,44 @@
+/* Ray statistics log writer. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "raylog.h"
+
+// buffered so a frame costs a memcpy, not a write
+#define RAYLOG_BUFFER (1 << 20)
+
+static FILE *rayLog;
+static uint32_t frames;
+
+int startRayLog(const char *path) {
+  rayLog = fopen(path, "wb");
+  if (!rayLog) {
+    perror(path);
+    return -1;
+  }
+  setvbuf(rayLog, NULL, _IOFBF, RAYLOG_BUFFER);
+  struct rayLogHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, RAYLOG_MAGIC, 4);
+  header.version = RAYLOG_VERSION;
+  header.maxDepth = MAX_DEPTH;
+  fwrite(&header, sizeof(header), 1, rayLog);
+  return 0;
+}
+
+void logRays(const struct camera *cam, int renderer,
+             const struct rayStat *rays, int cols) {
+  if (!rayLog)
+    return;
+  struct rayLogFrame frame = { frames++, cols, renderer, 0, *cam };
+  fwrite(&frame, sizeof(frame), 1, rayLog);
+  fwrite(rays, sizeof(struct rayStat), cols, rayLog);
+}
+
+void stopRayLog() {
+  if (!rayLog)
+    return;
+  fclose(rayLog);
+  rayLog = NULL;
+}
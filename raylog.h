@@ -0,0 +1,47 @@
+/* Ray statistics log.
+ *
+ * With --raylog FILE every frame appends what each
+ * column of the player's view hit and how much work
+ * its rays took (see struct rayStat) to FILE, for
+ * raystats to summarise. The file is a
+ * rayLogHeader, then per frame a rayLogFrame
+ * followed by its cols rayStats, all in host byte
+ * order.
+ */
+
+#ifndef RAYLOG_H
+#define RAYLOG_H
+
+#include <stdint.h>
+
+#include "doom_text.h"
+
+#define RAYLOG_MAGIC "DTRL"
+#define RAYLOG_VERSION 2
+
+struct rayLogHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t maxDepth;      // distance of a ray that hit nothing
+  uint32_t unused;
+};
+
+struct rayLogFrame {
+  uint32_t frame;
+  uint16_t cols;
+  uint8_t renderer;       // RENDER_*
+  uint8_t unused;
+  struct camera cam;      // where the view was from
+};
+
+// opens the log, -1 if that failed
+int startRayLog(const char *path);
+
+// appends one frame of cols columns
+void logRays(const struct camera *cam, int renderer,
+             const struct rayStat *rays, int cols);
+
+// flushes and closes the log
+void stopRayLog();
+
+#endif
@@ -0,0 +1,209 @@
+/* raystats - summary of a ray statistics log.
+ *
+ * Usage: raystats [-w COLS] [-t WORST] FILE
+ *
+ * Reads a log written with --raylog (see raylog.h)
+ * and prints how often rays ran all the way to
+ * MAX_DEPTH, a histogram of steps per ray, a heatmap
+ * of steps per screen column over time squeezed to
+ * COLS characters (80 by default) and the WORST
+ * frames (10 by default) by total steps, with the
+ * pose each was seen from, so slow viewpoints can
+ * be found and replayed.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "raylog.h"
+
+// rows of the heatmap, frames are grouped to fit
+#define HEAT_ROWS 32
+
+// histogram buckets, bucket b counts rays of fewer
+// than 2^b steps
+#define HISTOGRAM_BUCKETS 17
+
+struct worst {
+  struct rayLogFrame frame;
+  long steps;
+};
+
+static const char shades[] = " .:-=+*#%@";
+
+// the shade of value out of most
+static char shadeOf(double value, double most) {
+  if (most <= 0)
+    return shades[0];
+  int i = value / most * (sizeof(shades) - 2) + 0.5;
+  return shades[i < (int) sizeof(shades) - 2 ? i : (int) sizeof(shades) - 2];
+}
+
+static int bucketOf(int steps) {
+  int b = 0;
+  while (b < HISTOGRAM_BUCKETS - 1 && steps >= 1 << b)
+    b++;
+  return b;
+}
+
+static int byStepsDown(const void *a, const void *b) {
+  long x = ((const struct worst *) a)->steps;
+  long y = ((const struct worst *) b)->steps;
+  return (x < y) - (x > y);
+}
+
+int main(int argc, char **argv) {
+  int heatCols = 80, numWorst = 10;
+  const char *path = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+      heatCols = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+      numWorst = atoi(argv[++i]);
+    else
+      path = argv[i];
+  }
+  if (!path || heatCols < 1 || numWorst < 0) {
+    fprintf(stderr, "usage: %s [-w COLS] [-t WORST] FILE\n", argv[0]);
+    return 1;
+  }
+  FILE *in = fopen(path, "rb");
+  if (!in) {
+    perror(path);
+    return 1;
+  }
+  struct rayLogHeader header;
+  if (fread(&header, sizeof(header), 1, in) != 1 ||
+      memcmp(header.magic, RAYLOG_MAGIC, 4) != 0 ||
+      header.version != RAYLOG_VERSION) {
+    fprintf(stderr, "%s: not a ray log\n", path);
+    return 1;
+  }
+
+  // the whole log is read once, the heatmap needs
+  // to know how many frames there are up front
+  size_t frameCount = 0, frameSize = 0;
+  struct rayLogFrame *frames = NULL;
+  long *offsets = NULL;
+  struct rayStat *rays = NULL;
+  size_t rayCount = 0, raySize = 0;
+  struct rayLogFrame frame;
+  while (fread(&frame, sizeof(frame), 1, in) == 1) {
+    if (frameCount == frameSize) {
+      frameSize = frameSize ? frameSize * 2 : 1024;
+      frames = realloc(frames, frameSize * sizeof(*frames));
+      offsets = realloc(offsets, frameSize * sizeof(*offsets));
+    }
+    while (rayCount + frame.cols > raySize) {
+      raySize = raySize ? raySize * 2 : 65536;
+      rays = realloc(rays, raySize * sizeof(*rays));
+    }
+    if (fread(rays + rayCount, sizeof(*rays), frame.cols, in) != frame.cols) {
+      fprintf(stderr, "%s: cut short in frame %u\n", path, frame.frame);
+      break;
+    }
+    frames[frameCount] = frame;
+    offsets[frameCount++] = rayCount;
+    rayCount += frame.cols;
+  }
+  fclose(in);
+  if (!frameCount) {
+    fprintf(stderr, "%s: no frames\n", path);
+    return 1;
+  }
+
+  long histogram[HISTOGRAM_BUCKETS] = { 0 };
+  long totalSteps = 0, maxSteps = 0, outOfRange = 0;
+  double totalNanos = 0;
+  for (size_t i = 0; i < rayCount; i++) {
+    totalSteps += rays[i].steps;
+    totalNanos += rays[i].nanos;
+    if (rays[i].steps > maxSteps)
+      maxSteps = rays[i].steps;
+    if (rays[i].cellX < 0 && rays[i].distance >= header.maxDepth)
+      outOfRange++;
+    histogram[bucketOf(rays[i].steps)]++;
+  }
+  printf("%zu frames, %zu rays, %.1f steps per ray (most %ld), "
+         "%.0fns per ray, %.2f%% ran to MAX_DEPTH\n", frameCount, rayCount,
+         (double) totalSteps / rayCount, maxSteps, totalNanos / rayCount,
+         100.0 * outOfRange / rayCount);
+
+  printf("\nsteps per ray\n");
+  long mostInBucket = 0;
+  for (int b = 0; b < HISTOGRAM_BUCKETS; b++)
+    if (histogram[b] > mostInBucket)
+      mostInBucket = histogram[b];
+  for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+    if (!histogram[b])
+      continue;
+    int bar = histogram[b] * 50 / mostInBucket;
+    printf("  %6d..%-6d %9ld ", b ? 1 << (b - 1) : 0, (1 << b) - 1,
+           histogram[b]);
+    for (int i = 0; i < bar; i++)
+      putchar('#');
+    putchar('\n');
+  }
+
+  // mean steps per squeezed column, per group of
+  // frames and over the whole log
+  int rows = frameCount < HEAT_ROWS ? frameCount : HEAT_ROWS;
+  double *heat = calloc((rows + 1) * heatCols, sizeof(double));
+  long *samples = calloc((rows + 1) * heatCols, sizeof(long));
+  for (size_t f = 0; f < frameCount; f++) {
+    int row = f * rows / frameCount;
+    for (int col = 0; col < frames[f].cols; col++) {
+      int cell = col * heatCols / frames[f].cols;
+      int steps = rays[offsets[f] + col].steps;
+      heat[row * heatCols + cell] += steps;
+      samples[row * heatCols + cell]++;
+      heat[rows * heatCols + cell] += steps;
+      samples[rows * heatCols + cell]++;
+    }
+  }
+  double hottest = 0;
+  for (int i = 0; i < (rows + 1) * heatCols; i++) {
+    if (samples[i])
+      heat[i] /= samples[i];
+    if (heat[i] > hottest)
+      hottest = heat[i];
+  }
+  printf("\nsteps per column (%s is %.0f steps), frames down the side\n",
+         "@", hottest);
+  for (int row = 0; row <= rows; row++) {
+    if (row == rows)
+      printf("  %8s |", "all");
+    else
+      printf("  %8zu |", row * frameCount / rows);
+    for (int col = 0; col < heatCols; col++)
+      putchar(shadeOf(heat[row * heatCols + col], hottest));
+    printf("|\n");
+  }
+
+  if (numWorst) {
+    struct worst *worst = malloc(frameCount * sizeof(*worst));
+    for (size_t f = 0; f < frameCount; f++) {
+      worst[f].frame = frames[f];
+      worst[f].steps = 0;
+      for (int col = 0; col < frames[f].cols; col++)
+        worst[f].steps += rays[offsets[f] + col].steps;
+    }
+    qsort(worst, frameCount, sizeof(*worst), byStepsDown);
+    printf("\nslowest frames\n  %8s %9s %8s %8s %8s %8s\n", "frame",
+           "steps", "x", "y", "angle", "fov");
+    for (size_t i = 0; i < frameCount && i < (size_t) numWorst; i++) {
+      const struct rayLogFrame *f = &worst[i].frame;
+      printf("  %8u %9ld %8.3f %8.3f %8.4f %8.4f\n", f->frame,
+             worst[i].steps, f->cam.x, f->cam.y, f->cam.a, f->cam.fov);
+    }
+    free(worst);
+  }
+  free(heat);
+  free(samples);
+  free(frames);
+  free(offsets);
+  free(rays);
+  return 0;
+}
@@ -0,0 +1,276 @@
+/* Asciicast recorder: pty relay, ring buffer and
+ * writer thread.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "record.h"
+
+// most bytes the relay reads, and so records, at once
+#define RECORD_CHUNK 65536
+
+// what comes before each recorded chunk in the ring
+struct event {
+  double time;
+  uint32_t length;
+  char type;              // 'o' output or 'r' resize
+};
+
+// single producer, single consumer. head and tail
+// count every byte ever written and read, the ring
+// index is them modulo RECORD_RING
+static char *ring;
+static size_t head, tail;
+static bool done;
+static int stalls;        // times the relay had to wait
+static pthread_mutex_t ringLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ringData = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t ringSpace = PTHREAD_COND_INITIALIZER;
+
+static FILE *cast;
+static struct timespec started;
+static volatile sig_atomic_t resized;
+
+static double elapsed() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (t.tv_sec - started.tv_sec) + (t.tv_nsec - started.tv_nsec) / 1e9;
+}
+
+static void ringCopyIn(const void *data, size_t n) {
+  size_t at = head % RECORD_RING;
+  size_t first = n < RECORD_RING - at ? n : RECORD_RING - at;
+  memcpy(ring + at, data, first);
+  memcpy(ring, (const char *) data + first, n - first);
+  head += n;
+}
+
+static void ringCopyOut(void *data, size_t n) {
+  size_t at = tail % RECORD_RING;
+  size_t first = n < RECORD_RING - at ? n : RECORD_RING - at;
+  memcpy(data, ring + at, first);
+  memcpy((char *) data + first, ring, n - first);
+  tail += n;
+}
+
+// queues one event for the writer, waiting only when
+// the ring is full as the stream has to be exact
+static void record(char type, const char *data, size_t n) {
+  struct event e = { elapsed(), n, type };
+  size_t need = sizeof(e) + n;
+  pthread_mutex_lock(&ringLock);
+  if (RECORD_RING - (head - tail) < need)
+    stalls++;
+  while (RECORD_RING - (head - tail) < need)
+    pthread_cond_wait(&ringSpace, &ringLock);
+  bool wasEmpty = head == tail;
+  ringCopyIn(&e, sizeof(e));
+  ringCopyIn(data, n);
+  if (wasEmpty)
+    pthread_cond_signal(&ringData);
+  pthread_mutex_unlock(&ringLock);
+}
+
+// writes data as the inside of a JSON string
+static void writeString(const char *data, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    unsigned char c = data[i];
+    if (c == '"' || c == '\\')
+      fprintf(cast, "\\%c", c);
+    else if (c < 0x20 || c == 0x7f)
+      fprintf(cast, "\\u%04x", c);
+    else
+      putc(c, cast);
+  }
+}
+
+// how many bytes at the end of data start a UTF-8
+// character that is not finished yet
+static size_t unfinished(const char *data, size_t n) {
+  for (size_t back = 1; back <= 3 && back <= n; back++) {
+    unsigned char c = data[n - back];
+    if (c < 0x80)
+      return 0;
+    if (c >= 0xc0) {
+      size_t length = c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : 2;
+      return length > back ? back : 0;
+    }
+  }
+  return 0;
+}
+
+// turns the ring into asciicast lines. a character
+// split across two reads is held back so every
+// string stays valid UTF-8
+static void *writer(void *arg) {
+  (void) arg;
+  static char data[RECORD_CHUNK + 4];
+  static char other[RECORD_CHUNK];
+  size_t carried = 0;
+  while (1) {
+    pthread_mutex_lock(&ringLock);
+    while (head == tail && !done)
+      pthread_cond_wait(&ringData, &ringLock);
+    if (head == tail) {
+      pthread_mutex_unlock(&ringLock);
+      break;
+    }
+    struct event e;
+    ringCopyOut(&e, sizeof(e));
+    // only output continues a character, anything else
+    // is read aside and leaves the carry for the next
+    bool output = e.type == 'o';
+    ringCopyOut(output ? data + carried : other, e.length);
+    pthread_cond_signal(&ringSpace);
+    pthread_mutex_unlock(&ringLock);
+
+    fprintf(cast, "[%.6f, \"%c\", \"", e.time, e.type);
+    if (output) {
+      size_t n = carried + e.length;
+      carried = unfinished(data, n);
+      n -= carried;
+      writeString(data, n);
+      memmove(data, data + n, carried);
+    } else {
+      writeString(other, e.length);
+    }
+    fputs("\"]\n", cast);
+  }
+  return NULL;
+}
+
+static void onResize(int signal) {
+  (void) signal;
+  resized = 1;
+}
+
+static void writeAll(int fd, const char *data, size_t n) {
+  while (n > 0) {
+    ssize_t written = write(fd, data, n);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return;
+    data += written;
+    n -= written;
+  }
+}
+
+// copies keys to the game and its output to the
+// terminal and the ring until the game exits
+static void relay(int master) {
+  static char buffer[RECORD_CHUNK];
+  struct pollfd fds[2] = {
+    { STDIN_FILENO, POLLIN, 0 }, { master, POLLIN, 0 }
+  };
+  while (1) {
+    if (resized) {
+      resized = 0;
+      struct winsize size;
+      if (ioctl(STDIN_FILENO, TIOCGWINSZ, &size) == 0) {
+        ioctl(master, TIOCSWINSZ, &size);
+        char text[32];
+        record('r', text, snprintf(text, sizeof(text), "%dx%d",
+                                   size.ws_col, size.ws_row));
+      }
+    }
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    if (fds[0].revents & (POLLIN | POLLHUP)) {
+      ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+      if (n > 0)
+        writeAll(master, buffer, n);
+      else
+        fds[0].fd = -1;
+    }
+    if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+      ssize_t n = read(master, buffer, sizeof(buffer));
+      if (n <= 0)
+        break;
+      writeAll(STDOUT_FILENO, buffer, n);
+      record('o', buffer, n);
+    }
+  }
+}
+
+int startRecording(const char *path) {
+  struct winsize size = { 24, 80, 0, 0 };
+  ioctl(STDIN_FILENO, TIOCGWINSZ, &size);
+  const char *term = getenv("TERM");
+
+  cast = fopen(path, "w");
+  ring = malloc(RECORD_RING);
+  if (!cast || !ring) {
+    perror(path);
+    return -1;
+  }
+  fprintf(cast, "{\"version\": 2, \"width\": %d, \"height\": %d, "
+          "\"timestamp\": %ld, \"env\": {\"TERM\": \"%s\"}}\n",
+          size.ws_col, size.ws_row, (long) time(NULL), term ? term : "");
+  fflush(cast);
+
+  int master;
+  pid_t game = forkpty(&master, NULL, NULL, &size);
+  if (game < 0) {
+    perror("forkpty");
+    return -1;
+  }
+  if (game == 0) {
+    // the game, which knows nothing of the recording
+    fclose(cast);
+    free(ring);
+    return 0;
+  }
+
+  // the terminal is the games now, pass keys on raw
+  struct termios original, raw;
+  bool isTerminal = tcgetattr(STDIN_FILENO, &original) == 0;
+  if (isTerminal) {
+    raw = original;
+    cfmakeraw(&raw);
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+  }
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = onResize;
+  sigaction(SIGWINCH, &action, NULL);
+
+  clock_gettime(CLOCK_MONOTONIC, &started);
+  pthread_t thread;
+  pthread_create(&thread, NULL, writer, NULL);
+  relay(master);
+
+  pthread_mutex_lock(&ringLock);
+  done = true;
+  pthread_cond_signal(&ringData);
+  pthread_mutex_unlock(&ringLock);
+  pthread_join(thread, NULL);
+  fclose(cast);
+  if (isTerminal)
+    tcsetattr(STDIN_FILENO, TCSANOW, &original);
+
+  int status = 0;
+  waitpid(game, &status, 0);
+  if (stalls)
+    fprintf(stderr, "%s: the writer fell behind %d times\n", path, stalls);
+  exit(WIFEXITED(status) ? WEXITSTATUS(status) : 1);
+}
@@ -0,0 +1,28 @@
+/* Recording to asciicast v2.
+ *
+ * With --record FILE the game runs on a pseudo
+ * terminal of its own, the way `script` does it,
+ * and the original process stays behind to relay
+ * keys in and output out. Everything the game
+ * writes is copied into a preallocated ring buffer
+ * with the time it arrived, and a writer thread
+ * turns the ring into asciicast lines on disk, so
+ * neither the game nor the relay ever waits on the
+ * file. The recording is the exact byte stream the
+ * terminal was sent; play it back with castplay.
+ */
+
+#ifndef RECORD_H
+#define RECORD_H
+
+// bytes of output the ring holds before the relay
+// has to wait for the writer
+#define RECORD_RING (4 * 1024 * 1024)
+
+// starts recording to path. returns 0 in the process
+// that should go on to run the game, -1 if recording
+// could not start; the relay exits with the game
+// and never returns
+int startRecording(const char *path);
+
+#endif
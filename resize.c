@@ -0,0 +1,193 @@
+/* Screen sizing on SIGWINCH. */
+
+#define _GNU_SOURCE
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "aa.h"
+#include "audit.h"
+#include "glyph.h"
+#include "pool.h"
+#include "resize.h"
+#include "term.h"
+#include "clock.h"
+
+int screenW, screenH;
+chtype *framebuffer;
+float *depthBuffer;
+struct rayStat *rayBuffer;
+
+int resizeCount;
+double resizeSeconds;
+
+// set by the handler, the first frame lays out too
+static volatile sig_atomic_t pending = 1;
+
+static uint8_t *block;
+static size_t blockUsed;
+static int blockW, blockH;
+static struct scratch *scratch;
+static int numScratch;
+
+static void onResize(int signal) {
+  (void) signal;
+  pending = 1;
+}
+
+static size_t alignUp(size_t n, size_t to) {
+  return (n + to - 1) / to * to;
+}
+
+// hands out the next size bytes of the block, or
+// only counts them while base is NULL
+static void *carve(uint8_t *base, size_t *used, size_t size) {
+  void *p = base ? base + *used : NULL;
+  *used += alignUp(size, CACHE_LINE);
+  return p;
+}
+
+// lays the screen buffers and scratch for views up
+// to w x h out in base, returns the bytes it takes
+static size_t layout(uint8_t *base, int w, int h) {
+  size_t used = 0;
+  framebuffer = carve(base, &used, (size_t) w * h * sizeof(chtype));
+  depthBuffer = carve(base, &used, w * sizeof(float));
+  rayBuffer = carve(base, &used, w * sizeof(struct rayStat));
+
+  // renderers cast the most rays in glyph or AA mode
+  int most = GLYPH_SUB > AA_SUB ? GLYPH_SUB : AA_SUB;
+  int columns = w * most;
+  size_t stride = alignUp(w, CACHE_LINE);
+  for (int i = 0; i < numScratch; i++) {
+    struct scratch *s = &scratch[i];
+    s->rayX = carve(base, &used, columns * sizeof(float));
+    s->rayY = carve(base, &used, columns * sizeof(float));
+    s->solid = carve(base, &used, (columns + 63) / 64 * sizeof(uint64_t));
+    s->subrays = carve(base, &used, w * AA_SUB * sizeof(struct rayHit));
+    s->samples = carve(base, &used, GLYPH_SUB * h * GLYPH_SUB * stride);
+  }
+  return used;
+}
+
+// allocates the block for views up to w x h, only
+// ever between frames. false when memory runs out,
+// the old block and its layout are kept then
+static bool allocate(int w, int h) {
+  struct scratch *oldScratch = scratch;
+  int oldCount = numScratch;
+  if (numScratch != poolThreads()) {
+    numScratch = poolThreads();
+    scratch = malloc(numScratch * sizeof(struct scratch));
+  }
+  size_t used = scratch ? layout(NULL, w, h) : 0;
+  size_t size = alignUp(used, HUGE_PAGE);
+  uint8_t *fresh = scratch ? aligned_alloc(HUGE_PAGE, size) : NULL;
+  if (!fresh) {
+    if (scratch != oldScratch)
+      free(scratch);
+    scratch = oldScratch;
+    numScratch = oldCount;
+    if (block)
+      layout(block, blockW, blockH);
+    return false;
+  }
+  if (scratch != oldScratch)
+    free(oldScratch);
+  free(block);
+  block = fresh;
+  blockUsed = used;
+  blockW = w;
+  blockH = h;
+#ifdef MADV_HUGEPAGE
+  madvise(block, size, MADV_HUGEPAGE);
+#endif
+  layout(block, w, h);
+  return true;
+}
+
+// for the first block there is nothing to fall
+// back on
+static void allocateOrExit(int w, int h) {
+  if (!allocate(w, h)) {
+    fprintf(stderr, "no memory for a %dx%d screen\n", w, h);
+    exit(1);
+  }
+}
+
+// faults in one of count even parts of what the
+// block has laid out in it
+static void warmBlock(int index, void *arg) {
+  int count = *(int *) arg;
+  size_t part = alignUp(blockUsed / count, CACHE_LINE);
+  size_t first = part * index;
+  if (first < blockUsed)
+    memset(block + first, 0, first + part < blockUsed ? part :
+                             blockUsed - first);
+}
+
+void initResize() {
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = onResize;
+  sigaction(SIGWINCH, &action, NULL);
+}
+
+void prepareScreen() {
+  double start = now();
+  int w, h;
+  termSize(&w, &h);
+  allocateOrExit(w, h);
+  screenW = w;
+  screenH = h;
+  resizeCount++;
+  resizeSeconds = now() - start;
+
+  static int parts;
+  parts = poolThreads();
+  submitPool(warmBlock, parts, &parts);
+}
+
+bool resizeScreen() {
+  if (!pending)
+    return false;
+  pending = 0;
+  auditChanged();
+  double start = now();
+
+  int w, h;
+  termSize(&w, &h);
+  resizeTerm(w, h);
+  if (w == screenW && h == screenH && block)
+    return false;
+
+  // without memory for the new size the old one is
+  // drawn, until the next SIGWINCH tries again
+  if (!allocate(w, h))
+    return false;
+  screenW = w;
+  screenH = h;
+  resizeCount++;
+  resizeSeconds = now() - start;
+  return true;
+}
+
+void sizeScratch(int w, int h) {
+  allocateOrExit(w, h);
+}
+
+struct scratch *threadScratch() {
+  return &scratch[poolThread()];
+}
+
+void freeResize() {
+  free(block);
+  free(scratch);
+  block = NULL;
+  scratch = NULL;
+  blockW = blockH = 0;
+  numScratch = 0;
+}
@@ -0,0 +1,78 @@
+/* Screen sizing.
+ *
+ * Everything whose size follows the terminal's (the
+ * framebuffer, the depth and ray stat buffers and
+ * the renderers' scratch for every pool thread) is
+ * carved out of one block. The block is allocated
+ * again only when SIGWINCH says the terminal changed
+ * size, so frames in between allocate nothing and
+ * renderers never find a buffer too small.
+ *
+ * The block is aligned and padded to a huge page and
+ * the kernel is asked to back it with huge pages, and
+ * each buffer in it starts on its own cache line so
+ * threads writing neighbouring buffers do not share
+ * lines.
+ */
+
+#ifndef RESIZE_H
+#define RESIZE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "doom_text.h"
+
+// what the block is aligned and padded to
+#define HUGE_PAGE (2 * 1024 * 1024)
+
+// what each buffer in the block is aligned to
+#define CACHE_LINE 64
+
+// what a renderer on one pool thread draws with,
+// room for any view up to the size last laid out
+struct scratch {
+  float *rayX, *rayY;       // ray direction per render column
+  uint64_t *solid;          // a bit per render column
+  struct rayHit *subrays;   // AA_SUB per screen column
+  uint8_t *samples;         // glyph samples
+};
+
+// the screen and what is drawn into it, all valid
+// until the next resizeScreen that returns true
+extern int screenW, screenH;
+extern chtype *framebuffer;
+extern float *depthBuffer;        // screenW long
+extern struct rayStat *rayBuffer; // screenW long
+
+// resizes so far and what the last one took
+extern int resizeCount;
+extern double resizeSeconds;
+
+// catches SIGWINCH in place of ncurses, call after
+// startTerm and startPool. the first resizeScreen
+// always lays the screen out
+void initResize();
+
+// lays the screen out for the terminal's size before
+// the terminal is set up, and has the pool fault the
+// block in meanwhile; waitPool before the first
+// frame. the first resizeScreen then only checks
+void prepareScreen();
+
+// if the terminal changed size, resizes the backend
+// to it, lays out the block again and forces a full
+// repaint. returns whether it did
+bool resizeScreen();
+
+// lays out scratch for views up to w x h cells on
+// every pool thread, for rendering without a screen
+void sizeScratch(int w, int h);
+
+// the calling pool thread's scratch
+struct scratch *threadScratch();
+
+// frees the block
+void freeResize();
+
+#endif
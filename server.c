@@ -0,0 +1,300 @@
+/* Headless multiplayer server. Each tick it reads
+ * every waiting packet, plays the inputs in order,
+ * moves the bots, and sends every client a snapshot
+ * of what it can see (see interest.h), delta
+ * compressed against the last one that client
+ * acknowledged.
+ */
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "doom_text.h"
+#include "net.h"
+#include "interest.h"
+#include "clock.h"
+
+// where new players appear, the first floor cell
+// along the row from here
+#define SPAWN_X 8
+#define SPAWN_Y 8
+
+// ticks between bot moves, and the odds of a bot
+// turning on a move when it is not blocked
+#define BOT_MOVE_TICKS 4
+#define BOT_TURN_CHANCE 8
+
+struct client {
+  bool active;
+  bool bot;               // moved by the server, sent nothing
+  struct sockaddr_in addr;
+  struct playerState state;
+  uint32_t lastInput;     // last input sequence played
+  uint32_t ackTick;       // last snapshot it has
+  double lastHeard;
+  size_t bytesSent;       // this second
+  struct interest interest;
+  struct snapshot history[NET_HISTORY];  // as sent to it
+};
+
+// client slot i is entity i
+static struct client clients[MAX_ENTITIES];
+static struct snapshot world;
+static uint32_t tick;
+
+// interest totals over the current second
+static struct {
+  long visible, sent, snapshots;
+  double seconds;
+} interestTotals;
+
+static struct client *findClient(const struct sockaddr_in *addr) {
+  for (int i = 0; i < MAX_ENTITIES; i++)
+    if (clients[i].active && !clients[i].bot &&
+        clients[i].addr.sin_port == addr->sin_port &&
+        clients[i].addr.sin_addr.s_addr == addr->sin_addr.s_addr)
+      return &clients[i];
+  return NULL;
+}
+
+// takes a free slot, NULL if the server is full
+static struct client *newClient() {
+  for (int i = 0; i < MAX_ENTITIES; i++) {
+    struct client *c = &clients[i];
+    if (c->active)
+      continue;
+    memset(c, 0, sizeof(*c));
+    if (!startInterest(&c->interest))
+      return NULL;
+    c->active = true;
+    c->lastHeard = now();
+    return c;
+  }
+  return NULL;
+}
+
+static void addClient(const struct sockaddr_in *addr) {
+  struct client *c = newClient();
+  if (!c)
+    return;
+  int i = c - clients;
+  c->addr = *addr;
+  // on a map too small for it, the last row or column
+  int spawnX = SPAWN_X < mapWidth ? SPAWN_X : mapWidth - 1;
+  int spawnY = SPAWN_Y < mapHeight ? SPAWN_Y : mapHeight - 1;
+  c->state.x = spawnX + 0.5f;
+  c->state.y = spawnY + 0.5f;
+  for (int x = spawnX + i % (mapWidth - spawnX); x < mapWidth; x++) {
+    if (map[spawnY * mapWidth + x] != '#') {
+      c->state.x = x + 0.5f;
+      break;
+    }
+  }
+  printf("client %d joined from %s:%d\n", i, inet_ntoa(addr->sin_addr),
+         ntohs(addr->sin_port));
+}
+
+// bots start on a random floor cell facing anywhere
+static void addBot() {
+  struct client *c = newClient();
+  if (!c)
+    return;
+  c->bot = true;
+  int cell;
+  do {
+    cell = rand() % (mapWidth * mapHeight);
+  } while (map[cell] == '#');
+  c->state.x = cell % mapWidth + 0.5f;
+  c->state.y = cell / mapWidth + 0.5f;
+  c->state.a = rand() % 64 * M_PI / 32.0;
+}
+
+// bots walk forward and turn now and then, or when
+// a wall stops them
+static void moveBots() {
+  if (tick % BOT_MOVE_TICKS)
+    return;
+  for (int i = 0; i < MAX_ENTITIES; i++) {
+    struct client *c = &clients[i];
+    if (!c->active || !c->bot)
+      continue;
+    struct playerState before = c->state;
+    if (rand() % BOT_TURN_CHANCE)
+      applyInput(&c->state, INPUT_FORWARD);
+    if (c->state.x == before.x && c->state.y == before.y)
+      for (int turns = rand() % 16 + 1; turns > 0; turns--)
+        applyInput(&c->state, rand() % 2 ? INPUT_TURN_LEFT : INPUT_TURN_RIGHT);
+  }
+}
+
+static void readInputs(struct client *c, const uint8_t *p, ssize_t length) {
+  if (length < 10)
+    return;
+  uint32_t ack = get32(p + 1);
+  uint32_t first = get32(p + 5);
+  int count = p[9];
+  if (length < 10 + count)
+    return;
+
+  if (ack > c->ackTick && ack <= tick)
+    c->ackTick = ack;
+  for (int i = 0; i < count; i++) {
+    // anything already played was resent in case
+    // it got lost, skip it
+    if (first + i != c->lastInput + 1)
+      continue;
+    int input = p[10 + i];
+    if (input > INPUT_NONE && input < INPUTS)
+      applyInput(&c->state, input);
+    c->lastInput++;
+  }
+}
+
+static void receive(int sock) {
+  uint8_t packet[NET_PACKET];
+  struct sockaddr_in addr;
+  socklen_t addrLength = sizeof(addr);
+  ssize_t length;
+  while ((length = recvfrom(sock, packet, sizeof(packet), MSG_DONTWAIT,
+                            (struct sockaddr *) &addr, &addrLength)) > 0) {
+    struct client *c = findClient(&addr);
+    if (!c && packet[0] == PACKET_HELLO)
+      addClient(&addr);
+    if (!c)
+      continue;
+    c->lastHeard = now();
+    if (packet[0] == PACKET_INPUT)
+      readInputs(c, packet, length);
+    addrLength = sizeof(addr);
+  }
+}
+
+static void sendSnapshots(int sock) {
+  world.tick = tick;
+  world.count = 0;
+  for (int i = 0; i < MAX_ENTITIES; i++)
+    if (clients[i].active)
+      world.entities[world.count++] = quantiseEntity(i, &clients[i].state);
+
+  for (int i = 0; i < MAX_ENTITIES; i++) {
+    struct client *c = &clients[i];
+    if (!c->active || c->bot)
+      continue;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    struct snapshot *previous = &c->history[(tick - 1) % NET_HISTORY];
+    struct snapshot *sent = &c->history[tick % NET_HISTORY];
+    struct interestStats stats;
+    buildInterest(&c->interest, i, &world,
+                  previous->tick == tick - 1 ? previous : NULL, sent, &stats);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    interestTotals.visible += stats.visible;
+    interestTotals.sent += stats.sent;
+    interestTotals.snapshots++;
+    interestTotals.seconds += (end.tv_sec - start.tv_sec) +
+                              (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    // delta against what the client has, if we
+    // still have it too
+    const struct snapshot *base = NULL;
+    if (c->ackTick && tick - c->ackTick < NET_HISTORY &&
+        c->history[c->ackTick % NET_HISTORY].tick == c->ackTick)
+      base = &c->history[c->ackTick % NET_HISTORY];
+
+    uint8_t packet[NET_PACKET];
+    packet[0] = PACKET_SNAPSHOT;
+    put32(packet + 1, tick);
+    put32(packet + 5, base ? base->tick : 0);
+    put32(packet + 9, c->lastInput);
+    packet[13] = i;
+    size_t length = encodeEntities(packet + 14, sizeof(packet) - 14,
+                                   sent, base);
+    if (length == 0)
+      continue;
+    sendto(sock, packet, 14 + length, 0, (struct sockaddr *) &c->addr,
+           sizeof(c->addr));
+    c->bytesSent += 14 + length;
+  }
+}
+
+int runServer(int port, int bots) {
+  if (mapWidth > NET_MAP_MAX || mapHeight > NET_MAP_MAX) {
+    fprintf(stderr, "server: the map is %dx%d, positions only reach "
+            "%dx%d\n", mapWidth, mapHeight, NET_MAP_MAX, NET_MAP_MAX);
+    return 1;
+  }
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (sock < 0 || bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    perror("server");
+    return 1;
+  }
+  for (int i = 0; i < bots; i++)
+    addBot();
+  printf("serving on port %d at %d ticks a second with %d bots\n", port,
+         NET_TICK_HZ, bots);
+  fflush(stdout);
+
+  struct timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  double lastReport = now();
+  while (1) {
+    tick++;
+    receive(sock);
+    moveBots();
+
+    for (int i = 0; i < MAX_ENTITIES; i++) {
+      struct client *c = &clients[i];
+      if (c->active && !c->bot && now() - c->lastHeard > NET_TIMEOUT) {
+        c->active = false;
+        stopInterest(&c->interest);
+        printf("client %d timed out\n", i);
+      }
+    }
+
+    sendSnapshots(sock);
+
+    // bandwidth and interest per client once a second
+    double elapsed = now() - lastReport;
+    if (elapsed >= 1) {
+      int active = 0;
+      size_t total = 0;
+      for (int i = 0; i < MAX_ENTITIES; i++) {
+        if (!clients[i].active || clients[i].bot)
+          continue;
+        active++;
+        total += clients[i].bytesSent;
+        clients[i].bytesSent = 0;
+      }
+      long snapshots = interestTotals.snapshots ? interestTotals.snapshots : 1;
+      printf("tick %u clients %d entities %d sent %.0f B/s per client, "
+             "visible %.1f updated %.1f per snapshot, interest %.1fus\n",
+             tick, active, world.count, active ? total / elapsed / active : 0,
+             (double) interestTotals.visible / snapshots,
+             (double) interestTotals.sent / snapshots,
+             interestTotals.seconds * 1e6 / snapshots);
+      fflush(stdout);
+      memset(&interestTotals, 0, sizeof(interestTotals));
+      lastReport = now();
+    }
+
+    next.tv_nsec += 1000000000 / NET_TICK_HZ;
+    if (next.tv_nsec >= 1000000000) {
+      next.tv_nsec -= 1000000000;
+      next.tv_sec++;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+  }
+  close(sock);
+  return 0;
+}
@@ -0,0 +1,447 @@
+/* Session scheduler for --host. */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "doom_text.h"
+#include "player.h"
+#include "portal.h"
+#include "bsp.h"
+#include "pool.h"
+#include "session.h"
+#include "resize.h"
+#include "fixed.h"
+#include "term.h"
+#include "clock.h"
+
+// color pairs with a known escape sequence
+#define PAIRS (FLOOR_SHADE_START + SHADES)
+
+// unread input bytes kept per session
+#define SESSION_INPUT 64
+
+// seconds an ESC waits for the rest of an arrow key
+// before it counts as a key of its own
+#define ESCAPE_WAIT 0.05
+
+// starts a keyframe: reset colors, hide the cursor
+// and clear
+#define KEYFRAME_START "\x1b[0m\x1b[?25l\x1b[2J"
+
+// what ACS_CKBOARD is sent as, a UTF-8 shade block
+#define CKBOARD_UTF8 "\xe2\x96\x92"
+
+// leaves the terminal as it was found on the way out
+#define SESSION_END "\x1b[0m\x1b[?25h\x1b[2J\x1b[H"
+
+struct session {
+  int fd;
+  struct playerState player;
+  int renderer;
+
+  uint8_t input[SESSION_INPUT];
+  int inputLength;
+  double escapeSince;     // ESC waiting on the rest, 0 if none
+
+  chtype *cells;
+  chtype *previous;       // as last sent
+  bool keyframe;
+  bool dirty;             // input changed something
+  bool closing;           // hit 'q', close once sent
+
+  char *out;
+  size_t outLength, outSent, outSize;
+
+  double nextFrame;
+  double cost;            // CPU seconds of the last frame
+  double accepted;        // when it connected, 0 once it has a frame
+};
+
+static struct session *sessions[MAX_SESSIONS];
+static int numSessions;
+static int epollFd;
+
+// escape sequence that selects each color pair
+static char sgr[PAIRS][48];
+
+// totals over the current second
+static struct {
+  int frames, skipped, overruns;
+  double seconds;
+  int started;            // sessions that got their first frame
+  double startSeconds;    // from accept to that frame
+} totals;
+
+static double threadSeconds() {
+  struct timespec t;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// escape sequence color for a palette color, the
+// terminal default when there is none
+static int colorSGR(char *s, size_t size, short color, int base) {
+  short r, g, b;
+  if (color < 0 || !colorContent(color, &r, &g, &b))
+    return snprintf(s, size, ";%d", base + 9);
+  return snprintf(s, size, ";%d;2;%d;%d;%d", base + 8,
+                  r * 255 / 1000, g * 255 / 1000, b * 255 / 1000);
+}
+
+// the pairs main defined, as escape sequences
+static void buildPalette() {
+  for (int pair = 0; pair < PAIRS; pair++) {
+    short fg, bg;
+    char *s = sgr[pair];
+    int n = snprintf(s, sizeof(sgr[pair]), "\x1b[0");
+    if (pair != TEXT && pairContent(pair, &fg, &bg)) {
+      n += colorSGR(s + n, sizeof(sgr[pair]) - n, fg, 30);
+      n += colorSGR(s + n, sizeof(sgr[pair]) - n, bg, 40);
+    }
+    snprintf(s + n, sizeof(sgr[pair]) - n, "m");
+  }
+}
+
+static void emit(struct session *s, const char *data, size_t n) {
+  if (s->outLength + n > s->outSize) {
+    s->outSize = (s->outLength + n) * 2;
+    s->out = realloc(s->out, s->outSize);
+  }
+  memcpy(s->out + s->outLength, data, n);
+  s->outLength += n;
+}
+
+// appends the cells that changed since the last frame
+// sent, or all of them for a keyframe
+static void encodeFrame(struct session *s) {
+  if (s->keyframe)
+    emit(s, KEYFRAME_START, sizeof(KEYFRAME_START) - 1);
+
+  int cursorRow = -1, cursorCol = -1;
+  int pair = -1;
+  for (int row = 0; row < SESSION_ROWS; row++) {
+    for (int col = 0; col < SESSION_COLS; col++) {
+      int i = row * SESSION_COLS + col;
+      chtype cell = s->cells[i];
+      if (!s->keyframe && cell == s->previous[i])
+        continue;
+      s->previous[i] = cell;
+
+      char move[24];
+      if (row != cursorRow || col != cursorCol)
+        emit(s, move, snprintf(move, sizeof(move), "\x1b[%d;%dH",
+                               row + 1, col + 1));
+      int cellPair = PAIR_NUMBER(cell);
+      if (cellPair != pair && cellPair < PAIRS) {
+        emit(s, sgr[cellPair], strlen(sgr[cellPair]));
+        pair = cellPair;
+      }
+      if (cell & A_ALTCHARSET) {
+        emit(s, CKBOARD_UTF8, sizeof(CKBOARD_UTF8) - 1);
+      } else {
+        char ch = cell & A_CHARTEXT;
+        emit(s, &ch, 1);
+      }
+      cursorRow = row;
+      cursorCol = col + 1;
+    }
+  }
+  s->keyframe = false;
+}
+
+// plays every whole key in the input buffer, arrows
+// come as ESC [ C or ESC O C
+static void playInput(struct session *s) {
+  int i = 0;
+  while (i < s->inputLength) {
+    int input = INPUT_NONE;
+    uint8_t ch = s->input[i];
+    if (ch == 0x1b) {
+      // arrows are ESC [ or ESC O then A to D, any other
+      // ESC is a key and what follows it keys too
+      int left = s->inputLength - i;
+      bool intro = left >= 2 && (s->input[i + 1] == '[' ||
+                                 s->input[i + 1] == 'O');
+      if (left == 1 || (intro && left == 2)) {
+        if (!s->escapeSince)
+          s->escapeSince = now();
+        if (now() - s->escapeSince < ESCAPE_WAIT)
+          break;
+      }
+      s->escapeSince = 0;
+      uint8_t final = intro && left >= 3 ? s->input[i + 2] : 0;
+      if (final >= 'A' && final <= 'D') {
+        if (final == 'D')
+          input = INPUT_TURN_LEFT;
+        if (final == 'C')
+          input = INPUT_TURN_RIGHT;
+        i += 3;
+      } else {
+        i++;
+      }
+    } else {
+      i++;
+    }
+    switch (ch) {
+      case 'w': input = INPUT_FORWARD; break;
+      case 'a': input = INPUT_LEFT; break;
+      case 's': input = INPUT_BACK; break;
+      case 'd': input = INPUT_RIGHT; break;
+      case 'r': s->renderer = (s->renderer + 1) % RENDERERS; break;
+      case 'q': case 3: s->closing = true; break;
+    }
+    if (input != INPUT_NONE)
+      applyInput(&s->player, input);
+  }
+  memmove(s->input, s->input + i, s->inputLength - i);
+  s->inputLength -= i;
+}
+
+// one sessions simulation and frame, runs on the pool
+static void sessionTask(int index, void *arg) {
+  struct session *s = ((struct session **) arg)[index];
+  double start = threadSeconds();
+
+  playInput(s);
+  struct view v = {
+    { s->player.x, s->player.y, s->player.a, M_PI / 4.0f },
+    0, 0, SESSION_COLS, SESSION_ROWS, s->cells, SESSION_COLS, NULL, NULL
+  };
+  for (int i = 0; i < SESSION_COLS * SESSION_ROWS; i++)
+    s->cells[i] = ' ' | COLOR_PAIR(TEXT);
+  struct bspStats bspStats;
+  if (s->renderer == RENDER_PORTAL)
+    renderPortals(&v, SESSION_COLS, SESSION_ROWS);
+  else if (s->renderer == RENDER_BSP)
+    renderBSP(&v, &level, SESSION_COLS, SESSION_ROWS, &bspStats);
+  else if (fixedMath)
+    renderGridFixed(&v, SESSION_COLS, SESSION_ROWS);
+  else
+    renderGrid(&v, SESSION_COLS, SESSION_ROWS);
+  s->outLength = s->outSent = 0;
+  encodeFrame(s);
+  if (s->closing)
+    emit(s, SESSION_END, sizeof(SESSION_END) - 1);
+  // a waiting ESC is looked at again next frame
+  s->dirty = s->escapeSince > 0;
+
+  s->cost = threadSeconds() - start;
+}
+
+static void closeSession(int index) {
+  struct session *s = sessions[index];
+  close(s->fd);
+  free(s->cells);
+  free(s->previous);
+  free(s->out);
+  free(s);
+  sessions[index] = sessions[--numSessions];
+}
+
+static void acceptSessions(int listener) {
+  int fd;
+  while ((fd = accept4(listener, NULL, NULL,
+                       SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+    if (numSessions == MAX_SESSIONS) {
+      close(fd);
+      continue;
+    }
+    struct session *s = calloc(1, sizeof(struct session));
+    s->fd = fd;
+    s->player.x = s->player.y = 8;
+    s->cells = malloc(SESSION_COLS * SESSION_ROWS * sizeof(chtype));
+    s->previous = malloc(SESSION_COLS * SESSION_ROWS * sizeof(chtype));
+    s->keyframe = s->dirty = true;
+    s->nextFrame = s->accepted = now();
+    sessions[numSessions++] = s;
+
+    struct epoll_event event = { EPOLLIN, { .ptr = s } };
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+  }
+}
+
+// sends what it can, false once the session is over
+static bool flush(struct session *s) {
+  while (s->outSent < s->outLength) {
+    ssize_t n = send(s->fd, s->out + s->outSent, s->outLength - s->outSent,
+                     MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && errno == EAGAIN) {
+      struct epoll_event event = { EPOLLIN | EPOLLOUT, { .ptr = s } };
+      epoll_ctl(epollFd, EPOLL_CTL_MOD, s->fd, &event);
+      return true;
+    }
+    if (n <= 0)
+      return false;
+    s->outSent += n;
+  }
+  struct epoll_event event = { EPOLLIN, { .ptr = s } };
+  epoll_ctl(epollFd, EPOLL_CTL_MOD, s->fd, &event);
+  return !s->closing;
+}
+
+static int findSession(const struct session *s) {
+  for (int i = 0; i < numSessions; i++)
+    if (sessions[i] == s)
+      return i;
+  return -1;
+}
+
+// reads input and drains output for every socket
+// that is ready, waiting at most timeout ms
+static void waitSockets(int listener, int timeout) {
+  struct epoll_event events[64];
+  int count = epoll_wait(epollFd, events, 64, timeout);
+  for (int i = 0; i < count; i++) {
+    struct session *s = events[i].data.ptr;
+    if (!s) {
+      acceptSessions(listener);
+      continue;
+    }
+    bool open = true;
+    if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+      // keys beyond what the buffer holds are lost,
+      // the session is behind anyway
+      uint8_t input[SESSION_INPUT];
+      // EAGAIN and EINTR are left for the next wake
+      ssize_t n = read(s->fd, input, sizeof(input));
+      if (n > 0) {
+        if (n > SESSION_INPUT - s->inputLength)
+          n = SESSION_INPUT - s->inputLength;
+        memcpy(s->input + s->inputLength, input, n);
+        s->inputLength += n;
+        s->dirty = true;
+      } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+        open = false;
+      }
+    }
+    if (open && events[i].events & EPOLLOUT)
+      open = flush(s);
+    if (!open)
+      closeSession(findSession(s));
+  }
+}
+
+// most overdue first
+static int byDeadline(const void *a, const void *b) {
+  double x = (*(struct session **) a)->nextFrame;
+  double y = (*(struct session **) b)->nextFrame;
+  return (x > y) - (x < y);
+}
+
+int runHost(int port) {
+  int listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                        0);
+  int yes = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (listener < 0 || bind(listener, (struct sockaddr *) &addr,
+                           sizeof(addr)) < 0 || listen(listener, 128) < 0) {
+    perror("host");
+    return 1;
+  }
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event event = { EPOLLIN, { .ptr = NULL } };
+  epoll_ctl(epollFd, EPOLL_CTL_ADD, listener, &event);
+
+  buildPalette();
+  startPool();
+  sizeScratch(SESSION_COLS, SESSION_ROWS);
+  int threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads < 1)
+    threads = 1;
+  printf("hosting on port %d, %d threads\n", port, threads);
+  fflush(stdout);
+
+  static struct session *due[MAX_SESSIONS];
+  double interval = 1.0 / SESSION_FPS;
+  double lastReport = now();
+  while (1) {
+    // sleep until the next frame that is due, or
+    // until a socket wakes us
+    double wake = INFINITY;
+    for (int i = 0; i < numSessions; i++)
+      if (sessions[i]->dirty && sessions[i]->nextFrame < wake)
+        wake = sessions[i]->nextFrame;
+    int timeout = wake == INFINITY ? 1000 :
+                  fmax(0, ceil((wake - now()) * 1000));
+    waitSockets(listener, timeout);
+
+    // a session still sending its last frame skips
+    // this one, it will get a diff covering both
+    double t = now();
+    int count = 0;
+    for (int i = 0; i < numSessions; i++) {
+      struct session *s = sessions[i];
+      if (!s->dirty || s->nextFrame > t)
+        continue;
+      if (s->outSent < s->outLength) {
+        totals.skipped++;
+        continue;
+      }
+      due[count++] = s;
+    }
+    qsort(due, count, sizeof(due[0]), byDeadline);
+    if (count > threads * SESSION_ROUND)
+      count = threads * SESSION_ROUND;
+    runPool(sessionTask, count, due);
+
+    for (int i = 0; i < count; i++) {
+      struct session *s = due[i];
+      totals.frames++;
+      totals.seconds += s->cost;
+      double frames = 1;
+      if (s->cost * 1e6 > SESSION_BUDGET_US) {
+        totals.overruns++;
+        frames = s->cost * 1e6 / SESSION_BUDGET_US;
+      }
+      s->nextFrame = fmax(s->nextFrame + interval * frames, t);
+      if (s->accepted) {
+        totals.started++;
+        totals.startSeconds += now() - s->accepted;
+        s->accepted = 0;
+      }
+      if (!flush(s))
+        closeSession(findSession(s));
+    }
+
+    // sessions per core is how many sessions one
+    // core could keep at SESSION_FPS at this cost
+    double elapsed = now() - lastReport;
+    if (elapsed >= 1) {
+      double cost = totals.frames ? totals.seconds / totals.frames : 0;
+      printf("sessions %d frames %.0f/s skipped %d overruns %d "
+             "frame %.0fus sessions per core %.0f", numSessions,
+             totals.frames / elapsed, totals.skipped, totals.overruns,
+             cost * 1e6, cost ? 1 / (cost * SESSION_FPS) : 0);
+      // how long new sessions waited for a screen
+      if (totals.started)
+        printf(" started %d first frame %.2fms", totals.started,
+               totals.startSeconds / totals.started * 1000);
+      printf("\n");
+      fflush(stdout);
+      memset(&totals, 0, sizeof(totals));
+      lastReport = now();
+    }
+  }
+  stopPool();
+  freeResize();
+  close(listener);
+  return 0;
+}
@@ -0,0 +1,49 @@
+/* Hosted sessions.
+ *
+ * With --host PORT one process serves many players
+ * at once, each on its own TCP connection with its
+ * own game state, talking plain ANSI to a raw
+ * terminal (e.g. `stty raw -echo; nc HOST PORT`).
+ *
+ * The main thread waits on every socket with epoll
+ * and reads input as it arrives. Once a round it
+ * takes the sessions whose next frame is due, most
+ * overdue first, and runs each one's input and
+ * render as a task on the worker pool (see pool.h).
+ * Frames are diffed against the last one the
+ * session was sent and written back without
+ * blocking; a session whose output has not drained
+ * skips frames rather than queueing them.
+ *
+ * Each session gets SESSION_FPS frames a second at
+ * most, and only renders when its input changed
+ * something. A frame that costs more than
+ * SESSION_BUDGET_US of CPU pushes that sessions next
+ * frame back in proportion, so one heavy session
+ * cannot take a larger share of the pool.
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+// most sessions at once
+#define MAX_SESSIONS 1024
+
+// size of every sessions screen, raw sockets do not
+// say how big the terminal is
+#define SESSION_COLS 80
+#define SESSION_ROWS 24
+
+// frames a second a session renders at most
+#define SESSION_FPS 30
+
+// CPU one frame of one session should take
+#define SESSION_BUDGET_US 4000
+
+// most session tasks in one round, per thread
+#define SESSION_ROUND 8
+
+// serves sessions on port until killed
+int runHost(int port);
+
+#endif
@@ -0,0 +1,116 @@
+/* Shared memory framebuffer publisher. */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "share.h"
+#include "term.h"
+
+static struct shareHeader *header;
+static size_t mappedBytes;
+static char *shareName;
+static uint64_t frames;
+static struct timespec started;
+
+int startShare(const char *name) {
+  // shm_open wants one leading slash
+  shareName = malloc(strlen(name) + 2);
+  sprintf(shareName, "%s%s", name[0] == '/' ? "" : "/", name);
+
+  int fd = shm_open(shareName, O_CREAT | O_RDWR, 0644);
+  mappedBytes = sizeof(struct shareHeader) +
+                SHARE_SLOTS * sizeof(struct shareSlot);
+  if (fd < 0 || ftruncate(fd, mappedBytes) < 0) {
+    perror(name);
+    return -1;
+  }
+  header = mmap(NULL, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (header == MAP_FAILED) {
+    perror(name);
+    header = NULL;
+    return -1;
+  }
+
+  // a reader that finds the magic can trust the rest
+  memset(header, 0, sizeof(*header));
+  header->version = SHARE_VERSION;
+  header->slots = SHARE_SLOTS;
+  header->maxCols = SHARE_MAX_COLS;
+  header->maxRows = SHARE_MAX_ROWS;
+  header->slotBytes = sizeof(struct shareSlot);
+  for (int i = 0; i < SHARE_SLOTS; i++)
+    atomic_store(&shareSlot(header, i)->sequence, 0);
+  atomic_thread_fence(memory_order_release);
+  header->magic = SHARE_MAGIC;
+  clock_gettime(CLOCK_MONOTONIC, &started);
+  return 0;
+}
+
+// a palette color as 0xRRGGBB, black when unknown
+static uint32_t rgb(short color) {
+  short r, g, b;
+  if (color < 0 || !colorContent(color, &r, &g, &b))
+    return 0;
+  return (r * 255 / 1000) << 16 | (g * 255 / 1000) << 8 | b * 255 / 1000;
+}
+
+void sharePalette() {
+  if (!header)
+    return;
+  for (int pair = 0; pair < SHARE_PAIRS && pair < termPairs(); pair++) {
+    short fg, bg;
+    if (!pairContent(pair, &fg, &bg))
+      continue;
+    header->palette[pair][0] = rgb(fg);
+    header->palette[pair][1] = rgb(bg);
+  }
+}
+
+void shareFrame(const chtype *cells, int w, int h, const float *depth,
+                int depthCols) {
+  if (!header)
+    return;
+  int stride = w;
+  if (w > SHARE_MAX_COLS) w = SHARE_MAX_COLS;
+  if (h > SHARE_MAX_ROWS) h = SHARE_MAX_ROWS;
+  if (depthCols > w) depthCols = w;
+
+  // frames count from 1 so latest can say none yet
+  uint64_t frame = ++frames;
+  struct shareSlot *slot = shareSlot(header, frame);
+  atomic_store_explicit(&slot->sequence, 2 * frame + 1,
+                        memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  slot->frame = frame;
+  slot->time = (now.tv_sec - started.tv_sec) +
+               (now.tv_nsec - started.tv_nsec) / 1e9;
+  slot->w = w;
+  slot->h = h;
+  slot->depthCols = depthCols;
+  memcpy(slot->depth, depth, depthCols * sizeof(float));
+  for (int row = 0; row < h; row++)
+    for (int col = 0; col < w; col++)
+      slot->cells[row * w + col] = cells[row * stride + col];
+
+  atomic_store_explicit(&slot->sequence, 2 * frame + 2,
+                        memory_order_release);
+  atomic_store_explicit(&header->latest, frame, memory_order_release);
+}
+
+void stopShare() {
+  if (!header)
+    return;
+  munmap(header, mappedBytes);
+  shm_unlink(shareName);
+  free(shareName);
+  header = NULL;
+}
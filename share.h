@@ -0,0 +1,88 @@
+/* Shared memory framebuffer export.
+ *
+ * With --share NAME every finished framebuffer is
+ * published to the POSIX shared memory object NAME
+ * (/dev/shm/NAME on Linux), for tools that want
+ * frames without parsing a terminal. The object is
+ * a shareHeader followed by SHARE_SLOTS shareSlots.
+ *
+ * Frame n goes into slot n % SHARE_SLOTS under a
+ * sequence lock: the slot sequence is 2n + 1 while
+ * it is written and 2n + 2 once it is done, and
+ * then the header's latest is set to n. The game
+ * never waits for a reader. A reader picks a slot,
+ * checks the sequence is even, uses the frame where
+ * it lies and checks the sequence again afterwards;
+ * if it moved, the game lapped the reader and the
+ * frame may be torn (see shareview.c).
+ *
+ * Cells are ncurses chtype values, the character in
+ * the low 8 bits and the color pair in bits 8 to
+ * 15, whose colors are in the header's palette.
+ * depth holds the distance to the wall in each
+ * column of the player's view.
+ */
+
+#ifndef SHARE_H
+#define SHARE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "doom_text.h"
+
+#define SHARE_MAGIC 0x42465444u   // "DTFB" in memory
+#define SHARE_VERSION 1
+
+// frames kept, a reader has this many frames of
+// time to read one before it is overwritten
+#define SHARE_SLOTS 4
+
+// largest framebuffer that can be published
+#define SHARE_MAX_COLS 512
+#define SHARE_MAX_ROWS 256
+
+// color pairs in the palette
+#define SHARE_PAIRS 256
+
+struct shareHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slots;
+  uint32_t maxCols, maxRows;
+  uint32_t slotBytes;             // size of one shareSlot
+  uint32_t palette[SHARE_PAIRS][2];  // 0xRRGGBB foreground, background
+  _Atomic uint64_t latest;        // newest whole frame, 0 for none yet
+};
+
+struct shareSlot {
+  _Atomic uint64_t sequence;
+  uint64_t frame;
+  double time;                    // seconds since the game started
+  uint32_t w, h;                  // framebuffer size
+  uint32_t depthCols;             // columns with a depth
+  float depth[SHARE_MAX_COLS];
+  uint32_t cells[SHARE_MAX_COLS * SHARE_MAX_ROWS];
+};
+
+static inline struct shareSlot *shareSlot(struct shareHeader *header,
+                                          uint64_t frame) {
+  return (struct shareSlot *) (header + 1) + frame % SHARE_SLOTS;
+}
+
+// creates the shared memory object, -1 if that failed
+int startShare(const char *name);
+
+// takes the colors of every pair from ncurses, call
+// once the color pairs are defined
+void sharePalette();
+
+// publishes a w x h framebuffer, and depth for the
+// first depthCols columns. never blocks
+void shareFrame(const chtype *cells, int w, int h, const float *depth,
+                int depthCols);
+
+// unmaps and removes the object
+void stopShare();
+
+#endif
@@ -0,0 +1,167 @@
+/* shareview - reader for the shared framebuffer.
+ *
+ * Usage: shareview [-n FRAMES] [-p] NAME
+ *
+ * Follows the frames a game started with --share
+ * NAME publishes (see share.h) and reports how many
+ * it read whole, how many were torn because the
+ * game lapped it and how many it never saw. -p
+ * prints the last frame read, blank cells shaded by
+ * the brightness of their background, and the depth
+ * across the view.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "share.h"
+#include "clock.h"
+
+// how long to wait between looks at latest
+#define POLL_US 1000
+
+// copies the frame out of its slot, false if it was
+// overwritten before the copy was done
+static bool readFrame(struct shareHeader *header, uint64_t frame,
+                      struct shareSlot *out) {
+  struct shareSlot *slot = shareSlot(header, frame);
+  uint64_t before = atomic_load_explicit(&slot->sequence,
+                                         memory_order_acquire);
+  if (before != 2 * frame + 2)
+    return false;
+  out->frame = slot->frame;
+  out->time = slot->time;
+  out->w = slot->w < SHARE_MAX_COLS ? slot->w : SHARE_MAX_COLS;
+  out->h = slot->h < SHARE_MAX_ROWS ? slot->h : SHARE_MAX_ROWS;
+  out->depthCols = slot->depthCols < out->w ? slot->depthCols : out->w;
+  memcpy(out->depth, slot->depth, out->depthCols * sizeof(float));
+  memcpy(out->cells, slot->cells, out->w * out->h * sizeof(uint32_t));
+  atomic_thread_fence(memory_order_acquire);
+  return atomic_load_explicit(&slot->sequence, memory_order_relaxed) == before;
+}
+
+// walls are mostly blank cells in a colored pair,
+// so those are drawn as their background brightness
+static char cellChar(const struct shareHeader *header, uint32_t cell) {
+  static const char shades[] = " .:-=+*#%@";
+  char ch = cell & 0xff;
+  if (ch != ' ')
+    return ch;
+  uint32_t bg = header->palette[(cell >> 8) & 0xff][1];
+  int light = ((bg >> 16 & 0xff) + (bg >> 8 & 0xff) + (bg & 0xff)) / 3;
+  return shades[light * (sizeof(shades) - 2) / 255];
+}
+
+static void printFrame(const struct shareHeader *header,
+                       const struct shareSlot *slot) {
+  printf("frame %llu at %.3fs, %ux%u\n", (unsigned long long) slot->frame,
+         slot->time, slot->w, slot->h);
+  for (uint32_t row = 0; row < slot->h; row++) {
+    for (uint32_t col = 0; col < slot->w; col++)
+      putchar(cellChar(header, slot->cells[row * slot->w + col]));
+    putchar('\n');
+  }
+  if (!slot->depthCols)
+    return;
+  float nearest = MAX_DEPTH, furthest = 0, sum = 0;
+  for (uint32_t col = 0; col < slot->depthCols; col++) {
+    float d = slot->depth[col];
+    if (d < nearest) nearest = d;
+    if (d > furthest) furthest = d;
+    sum += d;
+  }
+  printf("depth over %u columns: nearest %.2f, mean %.2f, furthest %.2f\n",
+         slot->depthCols, nearest, sum / slot->depthCols, furthest);
+}
+
+int main(int argc, char **argv) {
+  long wanted = 0;
+  bool print = false;
+  const char *name = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+      wanted = atol(argv[++i]);
+    else if (strcmp(argv[i], "-p") == 0)
+      print = true;
+    else
+      name = argv[i];
+  }
+  if (!name) {
+    fprintf(stderr, "usage: %s [-n FRAMES] [-p] NAME\n", argv[0]);
+    return 1;
+  }
+
+  char path[256];
+  snprintf(path, sizeof(path), "%s%s", name[0] == '/' ? "" : "/", name);
+  int fd = shm_open(path, O_RDONLY, 0);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    perror(name);
+    return 1;
+  }
+  struct shareHeader *header = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED,
+                                    fd, 0);
+  close(fd);
+  if (header == MAP_FAILED) {
+    perror(name);
+    return 1;
+  }
+  atomic_thread_fence(memory_order_acquire);
+  if ((size_t) st.st_size < sizeof(*header) || header->magic != SHARE_MAGIC ||
+      header->version != SHARE_VERSION ||
+      header->slotBytes != sizeof(struct shareSlot) ||
+      (size_t) st.st_size < sizeof(*header) +
+                            header->slots * sizeof(struct shareSlot)) {
+    fprintf(stderr, "%s: not a shared framebuffer\n", name);
+    return 1;
+  }
+
+  // frames are read into one copy and kept in the
+  // other, so a torn read never replaces a whole one
+  struct shareSlot *frame = malloc(sizeof(*frame));
+  struct shareSlot *whole = malloc(sizeof(*whole));
+  long read = 0, torn = 0, missed = 0;
+  uint64_t last = atomic_load_explicit(&header->latest, memory_order_acquire);
+  uint64_t first = last;
+  double start = now(), idle = start;
+  // stops after wanted frames, or when the game has
+  // published nothing for a second
+  while (!wanted || read < wanted) {
+    uint64_t latest = atomic_load_explicit(&header->latest,
+                                           memory_order_acquire);
+    if (latest == last) {
+      if (now() - idle > 1.0)
+        break;
+      usleep(POLL_US);
+      continue;
+    }
+    idle = now();
+    if (last && latest > last + 1)
+      missed += latest - last - 1;
+    last = latest;
+    if (readFrame(header, latest, frame)) {
+      struct shareSlot *swap = whole;
+      whole = frame;
+      frame = swap;
+      read++;
+    } else
+      torn++;
+  }
+  double seconds = idle - start;
+
+  fprintf(stderr, "%ld frames read, %ld torn, %ld missed in %.3fs, "
+          "%.1f fps published\n", read, torn, missed, seconds,
+          seconds > 0 ? (last - first) / seconds : 0.0);
+  if (print && read)
+    printFrame(header, whole);
+  munmap(header, st.st_size);
+  return 0;
+}
@@ -0,0 +1,44 @@
+/* Startup phase timing. */
+
+#include <stdio.h>
+
+#include "startup.h"
+#include "clock.h"
+
+static double begin, last, done;
+
+static struct {
+  const char *name;
+  double seconds;
+} phases[MAX_PHASES];
+static int numPhases;
+
+void startupBegin() {
+  begin = last = now();
+}
+
+void startupPhase(const char *name) {
+  double t = now();
+  if (numPhases < MAX_PHASES) {
+    phases[numPhases].name = name;
+    phases[numPhases].seconds = t - last;
+    numPhases++;
+  }
+  last = t;
+}
+
+void startupDone() {
+  startupPhase("first frame");
+  done = last - begin;
+}
+
+double startupSeconds() {
+  return done;
+}
+
+void startupReport() {
+  for (int i = 0; i < numPhases; i++)
+    fprintf(stderr, "startup: %-12s %7.2fms\n", phases[i].name,
+            phases[i].seconds * 1000);
+  fprintf(stderr, "startup: %-12s %7.2fms\n", "total", done * 1000);
+}
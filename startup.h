@@ -0,0 +1,34 @@
+/* Startup profiling.
+ *
+ * main marks where each phase of startup ends, from
+ * the top of main to the first frame the terminal
+ * is sent, which is the one a user waits on. With
+ * --startup the phases are printed once the
+ * terminal has been given back; the debug line
+ * always shows the time to the first frame.
+ */
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+// phases that are kept, later ones are dropped
+#define MAX_PHASES 16
+
+// starts the clock, first thing in main
+void startupBegin();
+
+// ends the phase running since the last mark, name
+// has to outlive the process
+void startupPhase(const char *name);
+
+// ends startup with the first frame, once
+void startupDone();
+
+// seconds from startupBegin to startupDone, 0 until
+// then
+double startupSeconds();
+
+// prints every phase to stderr
+void startupReport();
+
+#endif
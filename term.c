@@ -0,0 +1,668 @@
+/* ncurses and direct ANSI terminal backends. */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "resize.h"
+#include "term.h"
+
+// alternate screen, no cursor, no colors, cleared
+#define ANSI_START "\x1b[?1049h\x1b[?25l\x1b[0m\x1b[2J"
+
+// and back to the screen the game started on, with
+// the palette the terminal had
+#define ANSI_END "\x1b[0m\x1b]104\x1b\\\x1b[?25h\x1b[?1049l"
+
+// what a signal leaves the terminal with: cancels an
+// escape cut short and a synchronized update left
+// open, then ANSI_END
+#define ANSI_ABORT "\x18\x1b[?2026l" ANSI_END
+
+// starts a frame that repaints every cell
+#define ANSI_KEYFRAME "\x1b[0m\x1b[2J"
+
+// begins and ends a synchronized update (DEC mode
+// 2026), the terminal shows nothing in between
+#define SYNC_BEGIN "\x1b[?2026h"
+#define SYNC_END "\x1b[?2026l"
+
+// asks whether mode 2026 is known (DECRQM)
+#define SYNC_QUERY "\x1b[?2026$p"
+
+// what ACS_CKBOARD is sent as, a UTF-8 shade block
+#define CKBOARD_UTF8 "\xe2\x96\x92"
+
+// most one cell can take to encode: a cursor move,
+// a color and a character
+#define CELL_BYTES (24 + 48 + 3)
+
+// colors with SGR codes of their own, 30 - 37 and
+// 90 - 97 for the foreground
+#define BASE_COLORS 16
+
+// redefining one palette color
+#define PALETTE_BYTES 32
+
+// unread input kept, enough for a few escapes
+#define INPUT_BYTES 64
+
+int termBackend = TERM_NCURSES;
+bool syncOutput;
+int coalescedFrames;
+chtype stippleChar = 'a' | A_ALTCHARSET;
+
+static volatile sig_atomic_t started;
+static struct termios original, rawMode;
+
+// ^Z gave the terminal back, and since it was taken
+// again the screen and palette need sending anew
+static volatile sig_atomic_t stopped, resumed;
+
+static short colors[TERM_COLORS][3];
+static bool colorKnown[TERM_COLORS];
+static short pairs[TERM_PAIRS][2];
+static bool pairKnown[TERM_PAIRS];
+
+// the SGR parameters that select each color as the
+// foreground and the background, the default ones
+// first. built again before a frame once the palette
+// changes
+static char codes[2][TERM_COLORS + 1][24];
+static bool codesStale = true;
+
+// what the backend has been given. a pair, and its
+// colors, are only programmed once a frame shows it
+static bool colorLive[TERM_COLORS];
+static bool pairLive[TERM_PAIRS];
+
+// live colors were changed, send them again
+static bool paletteStale;
+
+// the cells on the terminal, diffs are against it
+static chtype *previous;
+static int previousW, previousH;
+static bool keyframe = true;
+
+// the colors the terminal is drawing in
+static short termFg = -1, termBg = -1;
+
+// encode buffer, big enough for any frame, and how
+// much of the frame in it the terminal has taken
+static char *out;
+static size_t outLength, outSent, outSize;
+
+// stdout flags before it was made non-blocking
+static int outFlags;
+
+static unsigned char input[INPUT_BYTES];
+static int inputLength;
+
+static void writeAll(const char *s, size_t n) {
+  while (n > 0) {
+    ssize_t written = write(STDOUT_FILENO, s, n);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno != EAGAIN)
+        return;
+      struct pollfd fd = { STDOUT_FILENO, POLLOUT, 0 };
+      poll(&fd, 1, -1);
+      continue;
+    }
+    s += written;
+    n -= written;
+  }
+}
+
+// writes what the terminal takes of out without
+// waiting, true once it has all of it
+static bool flushOut() {
+  while (outSent < outLength) {
+    ssize_t written = write(STDOUT_FILENO, out + outSent,
+                            outLength - outSent);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written < 0 && errno == EAGAIN)
+      return false;
+    if (written <= 0) {
+      // the terminal is gone, nothing will get there
+      outSent = outLength;
+      break;
+    }
+    outSent += written;
+  }
+  return true;
+}
+
+// whether the terminal could take more output now
+static bool writable() {
+  struct pollfd fd = { STDOUT_FILENO, POLLOUT, 0 };
+  return poll(&fd, 1, 0) < 0 || (fd.revents & POLLOUT);
+}
+
+// takes the answer to SYNC_QUERY, the parameters of
+// a CSI sequence ending in y
+static void syncReply(const unsigned char *params, int length) {
+  int mode = 0;
+  char reply[INPUT_BYTES];
+  snprintf(reply, sizeof(reply), "%.*s", length, params);
+  // 1 and 2 are set and reset, 0 and 4 unknown and
+  // fixed
+  if (sscanf(reply, "?2026;%d$", &mode) == 1)
+    syncOutput = mode == 1 || mode == 2;
+}
+
+// gives the terminal back when a signal ends the
+// game, with async signal safe calls only, then lets
+// the signal do what it would have
+static void onSignal(int signal) {
+  if (started && termBackend == TERM_ANSI) {
+    started = false;
+    fcntl(STDOUT_FILENO, F_SETFL, outFlags);
+    if (write(STDOUT_FILENO, ANSI_ABORT, sizeof(ANSI_ABORT) - 1) < 0) {
+      // nothing more to do for a terminal that is gone
+    }
+    tcsetattr(STDIN_FILENO, TCSANOW, &original);
+  }
+  raise(signal);
+}
+
+// gives the terminal back as onSignal does, then
+// stops as ^Z would have
+static void onStop(int signal) {
+  (void) signal;
+  int saved = errno;
+  if (started && !stopped) {
+    stopped = true;
+    fcntl(STDOUT_FILENO, F_SETFL, outFlags);
+    if (write(STDOUT_FILENO, ANSI_ABORT, sizeof(ANSI_ABORT) - 1) < 0) {
+      // nothing more to do for a terminal that is gone
+    }
+    tcsetattr(STDIN_FILENO, TCSANOW, &original);
+  }
+  raise(SIGSTOP);
+  errno = saved;
+}
+
+// takes the terminal again as startTerm did, the
+// next frame repaints all of it
+static void onContinue(int signal) {
+  (void) signal;
+  int saved = errno;
+  if (started && stopped) {
+    stopped = false;
+    tcsetattr(STDIN_FILENO, TCSANOW, &rawMode);
+    if (write(STDOUT_FILENO, ANSI_START, sizeof(ANSI_START) - 1) < 0) {
+      // the next frame tries again
+    }
+    fcntl(STDOUT_FILENO, F_SETFL, outFlags | O_NONBLOCK);
+    resumed = true;
+  }
+  errno = saved;
+}
+
+int startTerm(int backend) {
+  termBackend = backend;
+  // ncurses catches signals itself, exit is for both
+  static bool hooked;
+  if (!hooked) {
+    atexit(stopTerm);
+    hooked = true;
+  }
+  if (backend == TERM_NCURSES) {
+    initscr();                  // init main window
+    cbreak();                   // dont buffer input
+    noecho();                   // dont echo input
+    nonl();                     // dont echo return -> newline
+    nodelay(stdscr, TRUE);      // dont block on getch
+    intrflush(stdscr, FALSE);   // dont flush output on interupt
+    keypad(stdscr, TRUE);       // enable terminal keypad
+    curs_set(0);                // hide cursor
+    start_color();
+    stippleChar = ACS_CKBOARD;
+    writeAll(SYNC_QUERY, sizeof(SYNC_QUERY) - 1);
+    started = true;
+    return 0;
+  }
+
+  if (tcgetattr(STDIN_FILENO, &original) < 0) {
+    perror("--ansi needs a terminal");
+    return -1;
+  }
+  // keys as they are hit, without echo and without
+  // waiting, but ^C still stops the game
+  rawMode = original;
+  rawMode.c_lflag &= ~(ICANON | ECHO);
+  rawMode.c_iflag &= ~(IXON | ICRNL);
+  rawMode.c_cc[VMIN] = 0;
+  rawMode.c_cc[VTIME] = 0;
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = onSignal;
+  action.sa_flags = SA_RESETHAND;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  sigaction(SIGHUP, &action, NULL);
+  // ^Z stops the game with the terminal given back,
+  // as ncurses does
+  action.sa_flags = SA_RESTART;
+  action.sa_handler = onStop;
+  sigaction(SIGTSTP, &action, NULL);
+  action.sa_handler = onContinue;
+  sigaction(SIGCONT, &action, NULL);
+  tcsetattr(STDIN_FILENO, TCSANOW, &rawMode);
+  writeAll(ANSI_START SYNC_QUERY, sizeof(ANSI_START SYNC_QUERY) - 1);
+  // frames are written without waiting, see flushOut
+  outFlags = fcntl(STDOUT_FILENO, F_GETFL);
+  fcntl(STDOUT_FILENO, F_SETFL, outFlags | O_NONBLOCK);
+  started = true;
+  return 0;
+}
+
+void stopTerm() {
+  if (!started)
+    return;
+  started = false;
+  if (termBackend == TERM_NCURSES) {
+    endwin();
+    return;
+  }
+  // the rest of the last frame goes first
+  fcntl(STDOUT_FILENO, F_SETFL, outFlags);
+  writeAll(out + outSent, outLength - outSent);
+  outLength = outSent = 0;
+  writeAll(ANSI_END, sizeof(ANSI_END) - 1);
+  tcsetattr(STDIN_FILENO, TCSANOW, &original);
+  free(previous);
+  free(out);
+  previous = NULL;
+  out = NULL;
+  previousW = previousH = 0;
+}
+
+int termColors() {
+  if (termBackend == TERM_ANSI)
+    return TERM_COLORS;
+  return has_colors() && can_change_color() ? COLORS : 0;
+}
+
+int termPairs() {
+  return termBackend == TERM_ANSI ? TERM_PAIRS : COLOR_PAIRS;
+}
+
+static void emit(const char *s, size_t n) {
+  memcpy(out + outLength, s, n);
+  outLength += n;
+}
+
+// defines one palette color on the terminal, as
+// ncurses does on init_color
+static void emitColor(short color) {
+  char define[PALETTE_BYTES];
+  emit(define, snprintf(define, sizeof(define),
+                        "\x1b]4;%d;rgb:%02x/%02x/%02x\x1b\\", color,
+                        colors[color][0] * 255 / 1000,
+                        colors[color][1] * 255 / 1000,
+                        colors[color][2] * 255 / 1000));
+}
+
+// programs a color, under ANSI only while a frame is
+// being encoded
+static void programColor(short color) {
+  if (color < 0 || color >= TERM_COLORS || !colorKnown[color])
+    return;
+  colorLive[color] = true;
+  if (termBackend == TERM_NCURSES)
+    init_color(color, colors[color][0], colors[color][1], colors[color][2]);
+  else
+    emitColor(color);
+}
+
+static void programPair(short pair) {
+  pairLive[pair] = true;
+  if (!pairKnown[pair])
+    return;
+  for (int i = 0; i < 2; i++) {
+    short color = pairs[pair][i];
+    if (color >= 0 && color < TERM_COLORS && !colorLive[color])
+      programColor(color);
+  }
+  if (termBackend == TERM_NCURSES)
+    init_pair(pair, pairs[pair][0], pairs[pair][1]);
+}
+
+void setColor(short color, short r, short g, short b) {
+  if (color < 0 || color >= TERM_COLORS) {
+    if (termBackend == TERM_NCURSES)
+      init_color(color, r, g, b);
+    return;
+  }
+  colors[color][0] = r;
+  colors[color][1] = g;
+  colors[color][2] = b;
+  colorKnown[color] = true;
+  codesStale = true;
+  // a color already on screen changes now
+  if (colorLive[color]) {
+    if (termBackend == TERM_NCURSES) {
+      programColor(color);
+    } else {
+      colorLive[color] = false;
+      paletteStale = true;
+    }
+  }
+}
+
+void setPair(short pair, short fg, short bg) {
+  if (pair < 0 || pair >= TERM_PAIRS) {
+    if (termBackend == TERM_NCURSES)
+      init_pair(pair, fg, bg);
+    return;
+  }
+  pairs[pair][0] = fg;
+  pairs[pair][1] = bg;
+  pairKnown[pair] = true;
+  if (pairLive[pair]) {
+    if (termBackend == TERM_NCURSES)
+      programPair(pair);
+    else
+      pairLive[pair] = false;
+  }
+}
+
+bool colorContent(short color, short *r, short *g, short *b) {
+  if (color < 0 || color >= TERM_COLORS || !colorKnown[color])
+    return false;
+  *r = colors[color][0];
+  *g = colors[color][1];
+  *b = colors[color][2];
+  return true;
+}
+
+bool pairContent(short pair, short *fg, short *bg) {
+  if (pair < 0 || pair >= TERM_PAIRS || !pairKnown[pair])
+    return false;
+  *fg = pairs[pair][0];
+  *bg = pairs[pair][1];
+  return true;
+}
+
+int termKey() {
+  if (termBackend == TERM_NCURSES) {
+    int key = getch();
+    if (key != 0x1b)
+      return key;
+    // keypad decodes the keys it knows, what is left
+    // starting with ESC [ is the reply to SYNC_QUERY
+    // or nothing we use
+    int next = getch();
+    if (next != '[') {
+      if (next != ERR)
+        ungetch(next);
+      return key;
+    }
+    unsigned char params[INPUT_BYTES];
+    int length = 0;
+    while ((next = getch()) != ERR && (next < 0x40 || next > 0x7e))
+      if (length < INPUT_BYTES)
+        params[length++] = next;
+    if (next == 'y')
+      syncReply(params, length);
+    return ERR;
+  }
+
+  if (inputLength < INPUT_BYTES) {
+    ssize_t n = read(STDIN_FILENO, input + inputLength,
+                     INPUT_BYTES - inputLength);
+    if (n > 0)
+      inputLength += n;
+  }
+  if (inputLength == 0)
+    return ERR;
+
+  int key = input[0], used = 1;
+  if (key == 0x1b && inputLength >= 2 &&
+      (input[1] == '[' || input[1] == 'O')) {
+    // an escape sequence runs to its final byte
+    while (++used < inputLength && (input[used] < 0x40 || input[used] > 0x7e))
+      ;
+    if (used == inputLength) {
+      // the rest has not arrived yet
+      if (inputLength == INPUT_BYTES)
+        inputLength = 0;
+      return ERR;
+    }
+    if (input[used] == 'y')
+      syncReply(input + 2, used - 2);
+    switch (input[used++]) {
+      case 'A': key = KEY_UP; break;
+      case 'B': key = KEY_DOWN; break;
+      case 'C': key = KEY_RIGHT; break;
+      case 'D': key = KEY_LEFT; break;
+      default:  key = ERR; break;
+    }
+  }
+  inputLength -= used;
+  memmove(input, input + used, inputLength);
+  return key;
+}
+
+void termSize(int *w, int *h) {
+  struct winsize size;
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col &&
+      size.ws_row) {
+    *w = size.ws_col;
+    *h = size.ws_row;
+  } else if (termBackend == TERM_NCURSES && stdscr) {
+    getmaxyx(stdscr, *h, *w);
+  } else {
+    *w = 80;
+    *h = 24;
+  }
+}
+
+void resizeTerm(int w, int h) {
+  if (termBackend == TERM_NCURSES) {
+    // ncurses no longer sees SIGWINCH, so it is told
+    // the new size here
+    resizeterm(h, w);
+    clearok(curscr, TRUE);
+  } else {
+    keyframe = true;
+  }
+}
+
+int drawText(int row, int col, short pair, const char *format, ...) {
+  char text[512];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  if (n > (int) sizeof(text) - 1)
+    n = sizeof(text) - 1;
+  for (int i = 0; i < n; i++)
+    drawChar(row, col + i, (unsigned char) text[i] | COLOR_PAIR(pair));
+  return col + n;
+}
+
+void drawChar(int row, int col, chtype ch) {
+  if (row >= 0 && row < screenH && col >= 0 && col < screenW)
+    framebuffer[row * screenW + col] = ch;
+}
+
+void clearRow(int row) {
+  for (int col = 0; col < screenW; col++)
+    drawChar(row, col, ' ' | COLOR_PAIR(TEXT));
+}
+
+// the parameters for a palette color, which is on
+// the terminal already, or the terminal default when
+// there is none
+static void colorCode(char *s, size_t size, short color, int base) {
+  if (color < 0 || !colorKnown[color])
+    snprintf(s, size, "%d", base + 9);
+  else if (color < BASE_COLORS / 2)
+    snprintf(s, size, "%d", base + color);
+  else if (color < BASE_COLORS)
+    snprintf(s, size, "%d", base + 60 + color - BASE_COLORS / 2);
+  else
+    snprintf(s, size, "%d;5;%d", base + 8, color);
+}
+
+static void buildCodes() {
+  for (int color = -1; color < TERM_COLORS; color++) {
+    colorCode(codes[0][color + 1], sizeof(codes[0][0]), color, 30);
+    colorCode(codes[1][color + 1], sizeof(codes[1][0]), color, 40);
+  }
+  codesStale = false;
+}
+
+// text keeps the terminal's own colors, as it does
+// for spectators
+static void cellColors(chtype cell, short *fg, short *bg) {
+  int pair = PAIR_NUMBER(cell);
+  *fg = *bg = -1;
+  if (pair != TEXT && pair < TERM_PAIRS && pairKnown[pair]) {
+    *fg = pairs[pair][0];
+    *bg = pairs[pair][1];
+  }
+}
+
+void presentFrame(const chtype *cells, int w, int h) {
+  if (termBackend == TERM_NCURSES) {
+    for (int i = 0; i < w * h; i++) {
+      int pair = PAIR_NUMBER(cells[i]);
+      if (pair < TERM_PAIRS && !pairLive[pair])
+        programPair(pair);
+    }
+    // stdscr is left alone too, or getch would
+    // refresh it
+    if (!writable()) {
+      coalescedFrames++;
+      return;
+    }
+    for (int row = 0; row < h; row++)
+      mvaddchnstr(row, 0, cells + row * w, w);
+    if (syncOutput)
+      writeAll(SYNC_BEGIN, sizeof(SYNC_BEGIN) - 1);
+    refresh();
+    if (syncOutput)
+      writeAll(SYNC_END, sizeof(SYNC_END) - 1);
+    return;
+  }
+
+  // back from ^Z the rest of the last frame is for a
+  // screen that is gone, and the palette was reset
+  if (resumed) {
+    resumed = false;
+    outSent = outLength;
+    keyframe = true;
+    memset(colorLive, 0, sizeof(colorLive));
+    paletteStale = true;
+  }
+  // the terminal is still taking the last frame, so
+  // this one is left out and the next diff, against
+  // previous, covers both
+  if (!flushOut()) {
+    coalescedFrames++;
+    return;
+  }
+
+  if (w != previousW || h != previousH) {
+    free(previous);
+    free(out);
+    previous = malloc(w * h * sizeof(chtype));
+    outSize = sizeof(SYNC_BEGIN) + sizeof(ANSI_KEYFRAME) +
+              TERM_COLORS * PALETTE_BYTES + (size_t) w * h * CELL_BYTES +
+              sizeof(SYNC_END);
+    out = malloc(outSize);
+    previousW = w;
+    previousH = h;
+    keyframe = true;
+  }
+  if (codesStale)
+    buildCodes();
+
+  // the whole frame is one synchronized update, so a
+  // terminal that gets it in pieces never shows half
+  outLength = outSent = 0;
+  if (syncOutput)
+    emit(SYNC_BEGIN, sizeof(SYNC_BEGIN) - 1);
+  size_t empty = outLength;
+
+  // colors that changed while on screen
+  if (paletteStale) {
+    for (int pair = 0; pair < TERM_PAIRS; pair++)
+      if (pairLive[pair])
+        programPair(pair);
+    paletteStale = false;
+  }
+  if (keyframe) {
+    emit(ANSI_KEYFRAME, sizeof(ANSI_KEYFRAME) - 1);
+    termFg = termBg = -1;
+  }
+  int cursorRow = -1, cursorCol = -1;
+  for (int row = 0; row < h; row++) {
+    for (int col = 0; col < w; col++) {
+      chtype cell = cells[row * w + col];
+      if (!keyframe && cell == previous[row * w + col])
+        continue;
+
+      // along the row is shorter than to a place
+      char move[24];
+      if (row == cursorRow && col != cursorCol)
+        emit(move, snprintf(move, sizeof(move), "\x1b[%dC",
+                            col - cursorCol));
+      else if (row != cursorRow)
+        emit(move, snprintf(move, sizeof(move), "\x1b[%d;%dH",
+                            row + 1, col + 1));
+      // only what changed is sent, and a blank only
+      // shows its background
+      int cellPair = PAIR_NUMBER(cell);
+      if (cellPair < TERM_PAIRS && !pairLive[cellPair])
+        programPair(cellPair);
+      short fg, bg;
+      cellColors(cell, &fg, &bg);
+      bool newFg = fg != termFg && (cell & (A_CHARTEXT | A_ALTCHARSET)) != ' ';
+      bool newBg = bg != termBg;
+      if (newFg || newBg) {
+        emit("\x1b[", 2);
+        if (newFg)
+          emit(codes[0][fg + 1], strlen(codes[0][fg + 1]));
+        if (newFg && newBg)
+          emit(";", 1);
+        if (newBg)
+          emit(codes[1][bg + 1], strlen(codes[1][bg + 1]));
+        emit("m", 1);
+        termFg = newFg ? fg : termFg;
+        termBg = bg;
+      }
+      if (cell & A_ALTCHARSET) {
+        emit(CKBOARD_UTF8, sizeof(CKBOARD_UTF8) - 1);
+      } else {
+        char ch = cell & A_CHARTEXT;
+        emit(&ch, 1);
+      }
+      cursorRow = row;
+      cursorCol = col + 1;
+    }
+  }
+  if (outLength == empty)
+    outLength = 0;
+  else if (syncOutput)
+    emit(SYNC_END, sizeof(SYNC_END) - 1);
+  flushOut();
+  memcpy(previous, cells, w * h * sizeof(chtype));
+  keyframe = false;
+}
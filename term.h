@@ -0,0 +1,108 @@
+/* Terminal backends.
+ *
+ * Every frame, overlays and all, is drawn into
+ * framebuffer (see resize.h) and handed to one of
+ * two backends. ncurses is the default. With --ansi
+ * the game drives the terminal itself: raw termios,
+ * the alternate screen and a hidden cursor, and each
+ * frame only the cells that changed since the last
+ * one go out as ANSI escapes, in one write. ncurses
+ * keeps a copy of the screen of its own and diffs
+ * against that, which the framebuffer makes twice
+ * the work.
+ *
+ * Both backends ask the terminal whether it knows
+ * synchronized output (DEC mode 2026) and, once it
+ * says so, wrap every frame in one synchronized
+ * update, so a frame the terminal reads in pieces
+ * is never shown half drawn. While the terminal is
+ * still taking the last frame a new one is not
+ * queued behind it: it is left out, and the next
+ * frame's diff covers both.
+ *
+ * Colors and pairs are defined through here with
+ * either backend and kept, so the broadcast and
+ * share palettes can read them back. Neither backend
+ * is given a pair, or its colors, until a frame
+ * shows it, so modes that are never turned on cost
+ * nothing at startup.
+ */
+
+#ifndef TERM_H
+#define TERM_H
+
+#include <stdbool.h>
+
+#include "doom_text.h"
+
+#define TERM_NCURSES 0
+#define TERM_ANSI 1
+
+// colors and pairs the ANSI backend has
+#define TERM_COLORS 256
+#define TERM_PAIRS 256
+
+// the backend startTerm was given
+extern int termBackend;
+
+// whether the terminal said it does synchronized
+// output, which can take a few frames to hear
+extern bool syncOutput;
+
+// frames left out while the terminal was behind
+extern int coalescedFrames;
+
+// what AA edges are stippled with, ACS_CKBOARD
+// once ncurses has started
+extern chtype stippleChar;
+
+// takes over the terminal, -1 if that failed
+int startTerm(int backend);
+
+// gives the terminal back as it was found, safe to
+// call more than once
+void stopTerm();
+
+// colors that can be defined, 0 if they are fixed,
+// and color pairs
+int termColors();
+int termPairs();
+
+// defines a color (components 0 - 1000) or a pair,
+// as init_color and init_pair but only once a frame
+// uses them
+void setColor(short color, short r, short g, short b);
+void setPair(short pair, short fg, short bg);
+
+// reads a color or pair back, false if it is not
+// known
+bool colorContent(short color, short *r, short *g, short *b);
+bool pairContent(short pair, short *fg, short *bg);
+
+// the next key, the arrows as KEY_LEFT and so on,
+// ERR if there is none. also takes the terminal's
+// replies
+int termKey();
+
+// the size of the terminal now
+void termSize(int *w, int *h);
+
+// takes the terminal to w x h and repaints all of
+// it with the next frame
+void resizeTerm(int w, int h);
+
+// writes text into framebuffer at row, col, clipped
+// to the screen, returns the column after it
+int drawText(int row, int col, short pair, const char *format, ...)
+  __attribute__((format(printf, 4, 5)));
+
+// sets one cell of framebuffer, if it is on screen
+void drawChar(int row, int col, chtype ch);
+
+// blanks one row of framebuffer
+void clearRow(int row);
+
+// puts the w x h cells on the terminal
+void presentFrame(const chtype *cells, int w, int h);
+
+#endif
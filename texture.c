@@ -0,0 +1,103 @@
+/* Procedural wall textures and their mips. */
+
+#include <stdlib.h>
+
+#include "texture.h"
+
+// cells per block sharing one texture
+#define TEXTURE_BLOCK 5
+
+static int8_t *atlas;
+
+// where each texture/mip starts in the atlas
+static int mipOffset[TEXTURES][TEX_MIPS];
+
+// small deterministic noise, -range to range
+static int noise(int texture, int u, int v, int range) {
+  unsigned int n = texture * 374761393u + u * 668265263u + v * 2246822519u;
+  n = (n ^ (n >> 13)) * 1274126177u;
+  n ^= n >> 16;
+  return (int) (n % (2 * range + 1)) - range;
+}
+
+static int8_t brick(int u, int v) {
+  int offset = (v / 8) % 2 ? 8 : 0;
+  if (v % 8 == 0 || (u + offset) % 16 == 0)
+    return -4;
+  return noise(0, u, v, 1);
+}
+
+static int8_t stone(int u, int v) {
+  if (u % 16 == 0 || v % 16 == 0)
+    return -3;
+  return noise(1, u / 2, v / 2, 2);
+}
+
+static int8_t panel(int u, int v) {
+  if (u % 8 == 0)
+    return 2;
+  if (u % 8 == 7)
+    return -3;
+  return v % 16 == 15 ? -1 : 0;
+}
+
+static int8_t rough(int u, int v) {
+  return noise(3, u, v, 2);
+}
+
+void buildTextures() {
+  int8_t (*generate[TEXTURES])(int, int) = { brick, stone, panel, rough };
+
+  int total = 0;
+  for (int t = 0; t < TEXTURES; t++) {
+    for (int m = 0; m < TEX_MIPS; m++) {
+      int size = TEX_SIZE >> m;
+      mipOffset[t][m] = total;
+      total += size * size;
+    }
+  }
+  free(atlas);
+  atlas = malloc(total);
+
+  for (int t = 0; t < TEXTURES; t++) {
+    int8_t *base = atlas + mipOffset[t][0];
+    for (int u = 0; u < TEX_SIZE; u++)
+      for (int v = 0; v < TEX_SIZE; v++)
+        base[u * TEX_SIZE + v] = generate[t](u, v);
+
+    // each mip averages 2x2 texels of the one above
+    for (int m = 1; m < TEX_MIPS; m++) {
+      int size = TEX_SIZE >> m;
+      const int8_t *src = atlas + mipOffset[t][m - 1];
+      int8_t *dst = atlas + mipOffset[t][m];
+      for (int u = 0; u < size; u++) {
+        for (int v = 0; v < size; v++) {
+          int sum = src[(2 * u) * 2 * size + 2 * v] +
+                    src[(2 * u) * 2 * size + 2 * v + 1] +
+                    src[(2 * u + 1) * 2 * size + 2 * v] +
+                    src[(2 * u + 1) * 2 * size + 2 * v + 1];
+          dst[u * size + v] = sum >= 0 ? (sum + 2) / 4 : -((-sum + 2) / 4);
+        }
+      }
+    }
+  }
+}
+
+int textureFor(int cellX, int cellY) {
+  return (cellX / TEXTURE_BLOCK + cellY / TEXTURE_BLOCK) % TEXTURES;
+}
+
+int mipForHeight(float span) {
+  int mip = 0;
+  while (mip < TEX_MIPS - 1 && (TEX_SIZE >> (mip + 1)) >= span)
+    mip++;
+  return mip;
+}
+
+const int8_t *textureColumn(int texture, int mip, float u) {
+  int size = TEX_SIZE >> mip;
+  int column = u * size;
+  if (column < 0) column = 0;
+  if (column > size - 1) column = size - 1;
+  return atlas + mipOffset[texture][mip] + column * size;
+}
@@ -0,0 +1,36 @@
+/* Wall textures.
+ *
+ * Textures are generated at startup into a single
+ * atlas. Each mip level is stored column-major,
+ * so the texels one screen column needs are one
+ * contiguous strip. A texel is a shade offset
+ * added to the lit wall shade.
+ */
+
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <stdint.h>
+
+// texels along each side of the largest mip
+#define TEX_SIZE 32
+
+// mip levels, down to 1x1
+#define TEX_MIPS 6
+
+// number of different wall textures
+#define TEXTURES 4
+
+// generates every texture and its mips
+void buildTextures();
+
+// which texture a wall cell is covered with
+int textureFor(int cellX, int cellY);
+
+// mip level to sample for a wall span this many rows high
+int mipForHeight(float span);
+
+// the strip of TEX_SIZE >> mip texels at u (0 - 1)
+const int8_t *textureColumn(int texture, int mip, float u);
+
+#endif
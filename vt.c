@@ -0,0 +1,263 @@
+/* Terminal state parser, see vt.h. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "vt.h"
+
+// most numeric parameters read from one CSI
+#define VT_PARAMS 16
+
+int vtOpen(struct vt *vt, int w, int h) {
+  memset(vt, 0, sizeof(*vt));
+  vt->w = w;
+  vt->h = h;
+  vt->cells = malloc(w * h * sizeof(struct vtCell));
+  if (!vt->cells)
+    return -1;
+  for (int i = 0; i < w * h; i++)
+    vt->cells[i] = (struct vtCell) { ' ', 0 };
+  vt->bottom = h - 1;
+  vt->last = ' ';
+  return 0;
+}
+
+void vtClose(struct vt *vt) {
+  free(vt->cells);
+  vt->cells = NULL;
+}
+
+static int clamp(int v, int low, int high) {
+  return v < low ? low : v > high ? high : v;
+}
+
+static void erase(struct vt *vt, int row, int from, int to) {
+  for (int x = from; x < to; x++)
+    vt->cells[row * vt->w + x] = (struct vtCell) { ' ', vt->bg };
+}
+
+// moves the lines of the scrolling region from
+// first on by n, up when n > 0, blanking behind them
+static void scroll(struct vt *vt, int first, int n) {
+  int lines = vt->bottom - first + 1;
+  if (n > lines) n = lines;
+  if (n < -lines) n = -lines;
+  struct vtCell *base = vt->cells + first * vt->w;
+  size_t row = vt->w * sizeof(struct vtCell);
+  if (n > 0) {
+    memmove(base, base + n * vt->w, (lines - n) * row);
+    for (int y = vt->bottom - n + 1; y <= vt->bottom; y++)
+      erase(vt, y, 0, vt->w);
+  } else if (n < 0) {
+    memmove(base - n * vt->w, base, (lines + n) * row);
+    for (int y = first; y < first - n; y++)
+      erase(vt, y, 0, vt->w);
+  }
+}
+
+// a line feed, scrolling at the bottom of the region
+static void lineDown(struct vt *vt) {
+  if (vt->y == vt->bottom)
+    scroll(vt, vt->top, 1);
+  else
+    vt->y = clamp(vt->y + 1, 0, vt->h - 1);
+}
+
+// a reverse line feed, scrolling at the top
+static void lineUp(struct vt *vt) {
+  if (vt->y == vt->top)
+    scroll(vt, vt->top, -1);
+  else
+    vt->y = clamp(vt->y - 1, 0, vt->h - 1);
+}
+
+static void put(struct vt *vt, char ch) {
+  // xterm holds the cursor at the last column
+  if (vt->x >= vt->w)
+    vt->x = vt->w - 1;
+  vt->cells[vt->y * vt->w + vt->x] = (struct vtCell) { ch, vt->bg };
+  vt->last = ch;
+  vt->x++;
+}
+
+static void sgr(struct vt *vt, const int *args, int count) {
+  if (count == 0)
+    vt->bg = 0;
+  for (int i = 0; i < count; i++) {
+    int a = args[i];
+    if (a == 0 || a == 49) {
+      vt->bg = 0;
+    } else if (a >= 40 && a <= 47) {
+      vt->bg = a - 40;
+    } else if (a >= 100 && a <= 107) {
+      vt->bg = a - 92;
+    } else if (a == 48 && i + 2 < count && args[i + 1] == 5) {
+      vt->bg = args[i + 2];
+      i += 2;
+    } else if (a == 48 && i + 4 < count && args[i + 1] == 2) {
+      vt->bg = VT_RGB | args[i + 2] << 16 | args[i + 3] << 8 | args[i + 4];
+      i += 4;
+    } else if ((a == 38 || a == 48) && i + 1 < count) {
+      // a foreground color, skip its arguments
+      i += args[i + 1] == 2 ? 4 : 2;
+    }
+  }
+}
+
+static void csi(struct vt *vt, const char *p, int length, char final) {
+  if (length > 0 && (p[0] == '?' || p[0] == '>'))
+    return;
+
+  int args[VT_PARAMS];
+  int count = 0;
+  if (length > 0) {
+    args[count] = 0;
+    for (int i = 0; i < length && count < VT_PARAMS; i++) {
+      if (p[i] == ';')
+        args[++count] = 0;
+      else if (p[i] >= '0' && p[i] <= '9')
+        args[count] = args[count] * 10 + p[i] - '0';
+    }
+    count = count < VT_PARAMS ? count + 1 : VT_PARAMS;
+  }
+  int n = count && args[0] ? args[0] : 1;
+  int *row = &vt->y, *col = &vt->x;
+
+  switch (final) {
+    case 'H': case 'f':
+      *row = clamp(n - 1, 0, vt->h - 1);
+      *col = clamp((count > 1 && args[1] ? args[1] : 1) - 1, 0, vt->w - 1);
+      break;
+    case 'd': *row = clamp(n - 1, 0, vt->h - 1); break;
+    case 'G': case '`': *col = clamp(n - 1, 0, vt->w - 1); break;
+    case 'A': *row = clamp(*row - n, 0, vt->h - 1); break;
+    case 'B': *row = clamp(*row + n, 0, vt->h - 1); break;
+    case 'C': *col = clamp(*col + n, 0, vt->w - 1); break;
+    case 'D': *col = clamp(*col - n, 0, vt->w - 1); break;
+    case 'K': {
+      int mode = count ? args[0] : 0;
+      int x = clamp(*col, 0, vt->w - 1);
+      if (mode == 0) erase(vt, *row, x, vt->w);
+      if (mode == 1) erase(vt, *row, 0, x + 1);
+      if (mode == 2) erase(vt, *row, 0, vt->w);
+      break;
+    }
+    case 'J': {
+      int mode = count ? args[0] : 0;
+      if (mode == 0) {
+        erase(vt, *row, clamp(*col, 0, vt->w), vt->w);
+        for (int y = *row + 1; y < vt->h; y++)
+          erase(vt, y, 0, vt->w);
+      } else if (mode == 2 || mode == 3) {
+        for (int y = 0; y < vt->h; y++)
+          erase(vt, y, 0, vt->w);
+      }
+      break;
+    }
+    case 'X':
+      erase(vt, *row, clamp(*col, 0, vt->w),
+            clamp(*col + n, 0, vt->w));
+      break;
+    case 'b':
+      for (int i = 0; i < n; i++)
+        put(vt, vt->last);
+      break;
+    case 'P': case '@': {
+      // delete or insert n cells at the cursor
+      struct vtCell *line = vt->cells + *row * vt->w;
+      int x = clamp(*col, 0, vt->w - 1);
+      n = clamp(n, 0, vt->w - x);
+      if (final == 'P') {
+        memmove(line + x, line + x + n, (vt->w - x - n) * sizeof(*line));
+        erase(vt, *row, vt->w - n, vt->w);
+      } else {
+        memmove(line + x + n, line + x, (vt->w - x - n) * sizeof(*line));
+        erase(vt, *row, x, x + n);
+      }
+      break;
+    }
+    case 'r':
+      vt->top = clamp(n - 1, 0, vt->h - 1);
+      vt->bottom = clamp((count > 1 && args[1] ? args[1] : vt->h) - 1,
+                         vt->top, vt->h - 1);
+      *row = *col = 0;
+      break;
+    case 'S': scroll(vt, vt->top, n); break;
+    case 'T': scroll(vt, vt->top, -n); break;
+    case 'L': case 'M':
+      // insert or delete lines at the cursor, inside
+      // the region
+      if (*row >= vt->top && *row <= vt->bottom)
+        scroll(vt, *row, final == 'M' ? n : -n);
+      break;
+    case 'm':
+      sgr(vt, args, count);
+      break;
+  }
+}
+
+// true once the escape sequence in pending is whole,
+// and applies it
+static int escape(struct vt *vt) {
+  const char *p = vt->pending;
+  int length = vt->pendingLength;
+  if (length < 2)
+    return 0;
+  char kind = p[1];
+  if (kind == '[') {
+    char final = p[length - 1];
+    if (length < 3 || final < 0x40 || final > 0x7e)
+      return 0;
+    csi(vt, p + 2, length - 3, final);
+    return 1;
+  }
+  if (kind == ']')
+    return p[length - 1] == '\a' ||
+           (length > 2 && p[length - 2] == '\x1b' && p[length - 1] == '\\');
+  if (kind == '(' || kind == ')')
+    return length == 3;
+  if (kind == 'M')
+    lineUp(vt);
+  if (kind == 'D')
+    lineDown(vt);
+  return 1;
+}
+
+void vtFeed(struct vt *vt, const char *data, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    char c = data[i];
+    if (vt->pendingLength || c == '\x1b') {
+      if (vt->pendingLength == VT_PENDING)
+        vt->pendingLength = 0;
+      vt->pending[vt->pendingLength++] = c;
+      if (escape(vt))
+        vt->pendingLength = 0;
+      continue;
+    }
+    unsigned char u = c;
+    if (c == '\r') {
+      vt->x = 0;
+    } else if (c == '\n') {
+      lineDown(vt);
+    } else if (c == '\b') {
+      vt->x = clamp(vt->x - 1, 0, vt->w - 1);
+    } else if (u >= 0xc0) {
+      // the start of a UTF-8 character, which the
+      // cell grid stands in for with one byte
+      put(vt, '+');
+    } else if (u >= ' ' && u < 0x7f) {
+      put(vt, c);
+    }
+  }
+}
+
+uint64_t vtHash(const struct vt *vt, int first, int last) {
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ull;
+  for (int i = first * vt->w; i < last * vt->w; i++) {
+    const struct vtCell *cell = &vt->cells[i];
+    hash = (hash ^ (uint8_t) cell->ch) * 1099511628211ull;
+    hash = (hash ^ cell->bg) * 1099511628211ull;
+  }
+  return hash;
+}
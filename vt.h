@@ -0,0 +1,60 @@
+/* A small terminal emulator for tools.
+ *
+ * Keeps the character and background color of every
+ * cell as escape sequences are fed in, enough of
+ * xterm to follow what ncurses and the broadcast
+ * encoder send: cursor movement, erasing, repeats,
+ * inserts and deletes, scrolling regions and SGR
+ * colors. Anything else is skipped. Sequences may
+ * be split across calls to vtFeed.
+ */
+
+#ifndef VT_H
+#define VT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// longest escape sequence kept between feeds
+#define VT_PENDING 64
+
+// background of a cell: a palette index, or a
+// truecolor value with VT_RGB set
+#define VT_RGB 0x1000000
+
+struct vtCell {
+  char ch;
+  uint32_t bg;
+};
+
+struct vt {
+  int w, h;
+  struct vtCell *cells;
+  int x, y;
+  int top, bottom;        // scrolling region, inclusive
+  uint32_t bg;
+  char last;              // last character drawn, for REP
+  char pending[VT_PENDING];
+  int pendingLength;
+};
+
+// a blank w x h screen, -1 if it could not be allocated
+int vtOpen(struct vt *vt, int w, int h);
+
+void vtClose(struct vt *vt);
+
+// applies n bytes of terminal output
+void vtFeed(struct vt *vt, const char *data, size_t n);
+
+// writes row as text into out, which holds w + 1
+static inline void vtRow(const struct vt *vt, int row, char *out) {
+  for (int x = 0; x < vt->w; x++)
+    out[x] = vt->cells[row * vt->w + x].ch;
+  out[vt->w] = '\0';
+}
+
+// a hash of rows first to last - 1, to tell whether
+// that part of the screen changed
+uint64_t vtHash(const struct vt *vt, int first, int last);
+
+#endif